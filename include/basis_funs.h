@@ -15,6 +15,7 @@
 // STL
 #include <cmath>
 #include <fstream>
+#include <vector>
 
 // My Headers
 
@@ -57,6 +58,13 @@ namespace BasisFun
      */
     BasisQ1(const typename Triangulation<dim>::active_cell_iterator &cell);
 
+    /*!
+     * Constructor from the vertices of a cell in the order of deal.II.
+     * Template specialization \f$dim=2\f$ and \f$dim=3\f$.
+     * @param vertices
+     */
+    BasisQ1(const std::vector<Point<dim>> &vertices);
+
     /*!
      * Copy constructor.
      */
@@ -117,12 +125,10 @@ namespace BasisFun
 
   // declare specializations
   template <>
-  BasisQ1<2>::BasisQ1(
-    const typename Triangulation<2>::active_cell_iterator &cell);
+  BasisQ1<2>::BasisQ1(const std::vector<Point<2>> &vertices);
 
   template <>
-  BasisQ1<3>::BasisQ1(
-    const typename Triangulation<3>::active_cell_iterator &cell);
+  BasisQ1<3>::BasisQ1(const std::vector<Point<3>> &vertices);
 
   template <>
   void
@@ -15,9 +15,20 @@ namespace BasisFun
   {}
 
 
+  template <int dim>
+  BasisQ1<dim>::BasisQ1(
+    const typename Triangulation<dim>::active_cell_iterator &cell)
+    : BasisQ1([&cell]() {
+        std::vector<Point<dim>> vertices(GeometryInfo<dim>::vertices_per_cell);
+        for (unsigned int i = 0; i < vertices.size(); ++i)
+          vertices[i] = cell->vertex(i);
+        return vertices;
+      }())
+  {}
+
+
   template <>
-  BasisQ1<2>::BasisQ1(
-    const typename Triangulation<2>::active_cell_iterator &cell)
+  BasisQ1<2>::BasisQ1(const std::vector<Point<2>> &vertices)
     : Function<2>(2)
     , index_basis(0)
     , coeff_matrix(4, 4)
@@ -26,7 +37,7 @@ namespace BasisFun
 
     for (unsigned int i = 0; i < 4; ++i)
       {
-        const Point<2> &p = cell->vertex(i);
+        const Point<2> &p = vertices[i];
 
         point_matrix(i, 0) = 1;
         point_matrix(i, 1) = p(0);
@@ -40,8 +51,7 @@ namespace BasisFun
 
 
   template <>
-  BasisQ1<3>::BasisQ1(
-    const typename Triangulation<3>::active_cell_iterator &cell)
+  BasisQ1<3>::BasisQ1(const std::vector<Point<3>> &vertices)
     : Function<3>(3)
     , index_basis(0)
     , coeff_matrix(8, 8)
@@ -50,7 +60,7 @@ namespace BasisFun
 
     for (unsigned int i = 0; i < 8; ++i)
       {
-        const Point<3> &p = cell->vertex(i);
+        const Point<3> &p = vertices[i];
 
         point_matrix(i, 0) = 1;
         point_matrix(i, 1) = p(0);
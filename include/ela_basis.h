@@ -23,6 +23,7 @@
 #include <deal.II/fe/fe_values_extractors.h>
 
 #include <deal.II/grid/grid_generator.h>
+#include <deal.II/grid/grid_refinement.h>
 #include <deal.II/grid/grid_tools.h>
 #include <deal.II/grid/tria.h>
 
@@ -55,16 +56,88 @@
 #include "process_parameter_file.h"
 
 // STL
+#include <algorithm>
 #include <cmath>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
 
 
 namespace Elasticity
 {
   using namespace dealii;
 
+  /**
+   * @brief Cell matrices and right-hand side of the fine-scale problems.
+   *
+   * @tparam dim Space dimension
+   *
+   * ElaBasis and ElaBasisDistributed integrate the same bilinear form on
+   * their fine meshes. The parts of the two Lamé parameters are kept apart
+   * for GlobalParameters::affine_decomposition. The right-hand side is that
+   * of a unit mass density, so ElaMs can scale it for each load case.
+   */
+  template <int dim>
+  class ElaLocalAssembler
+  {
+  public:
+    /**
+     * @brief Construct a new ElaLocalAssembler object.
+     *
+     * @param fe The finite element of the fine mesh. It must live longer
+     *           than this object.
+     * @param global_parameters Shared handle to the parameters that many
+     *                          classes need.
+     * @param lame_scaling Scaling of the Lamé parameters in #cell_matrix
+     */
+    ElaLocalAssembler(
+      const FiniteElement<dim> &                          fe,
+      const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+      const LameScaling &                                 lame_scaling);
+
+    /**
+     * @brief Computes the cell matrices and the right-hand side on a cell.
+     *
+     * @param cell Cell of the fine mesh
+     */
+    void
+    assemble(const typename DoFHandler<dim>::active_cell_iterator &cell);
+
+    FullMatrix<double> cell_matrix;   /**< Scaled sum of the two parts */
+    FullMatrix<double> matrix_lambda; /**< Part of the first Lamé parameter */
+    FullMatrix<double> matrix_mu;     /**< Part of the second Lamé parameter */
+    Vector<double>     cell_rhs;      /**< Right-hand side */
+
+  private:
+    const QGauss<dim>                                  quadrature_formula;
+    FEValues<dim>                                      fe_values;
+    const std::shared_ptr<const GlobalParameters<dim>> global_parameters;
+    const LameScaling                                  lame_scaling;
+    BodyForce<dim>                                     body_force;
+    std::vector<double>                                lambda_values;
+    std::vector<double>                                mu_values;
+    std::vector<Vector<double>>                        body_force_values;
+  };
+
+
+  /**
+   * @brief Packs the element right-hand side and matrices of a coarse cell.
+   *
+   * @param rhs The element right-hand side
+   * @param matrices The element matrices
+   * @return std::vector<double> The rhs followed by the entries of each
+   *         matrix row by row
+   *
+   * This is the first part of ElaBasis::pack_result().
+   */
+  std::vector<double>
+  pack_element_system(const Vector<double> &                         rhs,
+                      const std::vector<const FullMatrix<double> *> &matrices);
+
+
   /**
    * @brief Fine-scale basis class for MsFEMs in linear elasticity.
    *
@@ -79,6 +152,14 @@ namespace Elasticity
    * Furthermore, if given the solution of ElaMs, it can output
    * the solution with the basis functions that are generated here.
    *
+   * With more than one level in ParametersBasis::n_levels, the fine-scale
+   * problem is itself solved with an MsFEM: the basis functions are
+   * computed on an intermediate mesh whose cells get their own ElaBasis
+   * objects with one level less. The coarse cell must then be a box.
+   *
+   * Otherwise, the fine mesh can also be refined adaptively, see
+   * ParametersBasis::refinement.
+   *
    * Based on the implementations in the repository
    * https://github.com/konsim83/MPI-MSFEC/
    */
@@ -96,15 +177,48 @@ namespace Elasticity
      *                        processor that solves this problem.
      * @param mpi_communicator The MPI-communicator
      * @param parameters_basis Parameters that only this class needs.
-     * @param global_parameters Parameters that many classes need.
+     * @param global_parameters Shared handle to the parameters that many
+     *                          classes need.
+     * @param cycle The refinement cycle
+     * @param lame_scaling Scaling of the Lamé parameters for which the
+     *                     basis functions are constructed.
+     */
+    ElaBasis(
+      typename Triangulation<dim>::active_cell_iterator & global_cell,
+      typename Triangulation<dim>::active_cell_iterator & first_cell,
+      unsigned int                                        local_subdomain,
+      MPI_Comm                                            mpi_communicator,
+      const ParametersBasis &                             parameters_basis,
+      const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+      const unsigned int                                  cycle,
+      const LameScaling &                                 lame_scaling);
+
+    /**
+     * @brief Construct a new ElaBasis object for a cell of another
+     *        processor.
+     *
+     * @param corner_points The vertices of the cell
+     * @param global_cell_id The id of the cell
+     * @param mpi_communicator The MPI-communicator
+     * @param parameters_basis Parameters that only this class needs. The
+     *                         basis functions are not written to files.
+     * @param global_parameters Shared handle to the parameters that many
+     *                          classes need.
+     * @param cycle The refinement cycle
+     * @param lame_scaling Scaling of the Lamé parameters for which the
+     *                     basis functions are constructed.
+     *
+     * The results of run() are sent to the owner of the cell with
+     * pack_result().
      */
-    ElaBasis(typename Triangulation<dim>::active_cell_iterator &global_cell,
-             typename Triangulation<dim>::active_cell_iterator &first_cell,
-             unsigned int                                       local_subdomain,
-             MPI_Comm                     mpi_communicator,
-             const ParametersBasis &      parameters_basis,
-             const GlobalParameters<dim> &global_parameters,
-             const unsigned int           cycle);
+    ElaBasis(
+      const std::vector<Point<dim>> &                     corner_points,
+      const CellId &                                      global_cell_id,
+      MPI_Comm                                            mpi_communicator,
+      const ParametersBasis &                             parameters_basis,
+      const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+      const unsigned int                                  cycle,
+      const LameScaling &                                 lame_scaling);
 
     /**
      * @brief Copy Constructor for Ela Basis.
@@ -123,9 +237,14 @@ namespace Elasticity
      * If this is the first cell on this processor and verbose of
      * #parameters_basis is true, an output for the constructed
      * basis function will be created.
+     *
+     * @param progress_callback If not empty, it is called after each basis
+     *                          function, e.g. to serve messages of other
+     *                          processors during long computations.
      */
     void
-    run();
+    run(const std::function<void()> &progress_callback =
+          std::function<void()>());
 
     /**
      * @brief Returns the #global_element_matrix.
@@ -135,10 +254,34 @@ namespace Elasticity
     const FullMatrix<double> &
     get_global_element_matrix() const;
 
+    /**
+     * @brief Returns the #element_matrix_lambda.
+     *
+     * @return const FullMatrix<double>&
+     *
+     * Only available if GlobalParameters::affine_decomposition is true.
+     */
+    const FullMatrix<double> &
+    get_element_matrix_lambda() const;
+
+    /**
+     * @brief Returns the #element_matrix_mu.
+     *
+     * @return const FullMatrix<double>&
+     *
+     * Only available if GlobalParameters::affine_decomposition is true.
+     */
+    const FullMatrix<double> &
+    get_element_matrix_mu() const;
+
     /**
      * @brief Returns the #global_element_rhs.
      *
      * @return const Vector<double>&
+     *
+     * The body force is computed for a unit mass density, i.e. the
+     * returned vector has to be scaled with the mass density of the load
+     * case.
      */
     const Vector<double> &
     get_global_element_rhs() const;
@@ -151,13 +294,81 @@ namespace Elasticity
      */
     void
     set_global_weights(const std::vector<double> &global_weights);
+
+    /**
+     * @brief Evaluates the local contribution to the global solution
+     *        at the quadrature points of the fine cells.
+     *
+     * @param points Quadrature points, the new points are appended.
+     * @param JxW Quadrature weights times the Jacobian determinant
+     * @param values Displacement at the quadrature points
+     * @param gradients Gradient of the displacement at the quadrature
+     *                  points
+     *
+     * set_global_weights() must have been called before.
+     */
+    void
+    append_global_solution_at_quadrature_points(
+      std::vector<Point<dim>> &    points,
+      std::vector<double> &        JxW,
+      std::vector<Tensor<1, dim>> &values,
+      std::vector<Tensor<2, dim>> &gradients) const;
+
+    /**
+     * @brief Returns the values of the basis functions at the vertices of
+     *        the fine mesh.
+     *
+     * @param values Value of the basis function i for the component c at
+     *               the vertex with the index v (see
+     *               MyTools::get_lattice_index()) in the entry
+     *               (c + dim * v) * dofs_per_cell + i
+     *
+     * The coarse cell must be a box. The lattice is that of the uniformly
+     * refined mesh, on adaptive or anisotropic meshes the basis functions
+     * are evaluated at its vertices.
+     */
+    void
+    get_basis_values_on_lattice(std::vector<double> &values) const;
+
+    /**
+     * @brief Packs the results of run() for another processor.
+     *
+     * @return std::vector<double> The #global_element_rhs, the
+     *         #global_element_matrix, with
+     *         GlobalParameters::affine_decomposition the
+     *         #element_matrix_lambda and the #element_matrix_mu, and the
+     *         basis functions in the layout of get_basis_values_on_lattice(),
+     *         on an anisotropic mesh on its own lattice (see
+     *         get_lattice_intervals())
+     */
+    std::vector<double>
+    pack_result() const;
+
+    /**
+     * @brief Sets the results that another processor computed for this cell
+     *        instead of calling run().
+     *
+     * @param result The output of pack_result()
+     *
+     * The fine mesh is rebuilt as in run() without adaptive refinement, so
+     * the basis functions can be evaluated and written as if they were
+     * computed on this processor.
+     */
+    void
+    unpack_result(const std::vector<double> &result);
+
     void
 
     /**
      * @brief Creates a .vtu output file with the local contribution
      *        to the global solution with the local basis functions.
+     *
+     * @param material Index of the material in
+     *                 GlobalParameters::material_sweep
+     * @param load_case Index of the load case in GlobalParameters::load_cases
      */
-    output_global_solution_in_cell();
+    output_global_solution_in_cell(const unsigned int material,
+                                   const unsigned int load_case);
 
     /**
      * @brief Return the filename for the local contribution to
@@ -169,6 +380,89 @@ namespace Elasticity
     get_filename() const;
 
   private:
+    /**
+     * @brief Creates the fine mesh of the cell.
+     *
+     * @param n_refine Number of global refinements of the cell
+     */
+    void
+    make_grid(const unsigned int n_refine);
+
+    /**
+     * @brief Creates the fine mesh of the cell with refinements only in the
+     *        directions in which the material varies.
+     *
+     * Horizontal layers and oscillations vary in x-direction, y-layers in
+     * y-direction and vertical layers in the last direction. Other
+     * materials get the mesh of make_grid().
+     */
+    void
+    make_anisotropic_grid();
+
+    /**
+     * @brief Returns the directions of make_anisotropic_grid() as a
+     *        refinement case.
+     *
+     * @return RefinementCase<dim> RefinementCase::no_refinement if the
+     *         material is not layered
+     */
+    RefinementCase<dim>
+    get_anisotropic_refinement_case() const;
+
+    /**
+     * @brief Returns whether run() computes the basis functions on the
+     *        intermediate mesh of assemble_system_multilevel().
+     */
+    bool
+    is_multilevel() const;
+
+    /**
+     * @brief Returns the number of intervals of the lattice in each
+     *        direction.
+     *
+     * @return std::vector<unsigned int> 2^ParametersBasis::n_refine, or 1 in
+     *         the directions in which an anisotropic mesh is not refined
+     *
+     * The vertices of the lattice are those of the mesh of run() without
+     * adaptive refinement.
+     */
+    std::vector<unsigned int>
+    get_lattice_intervals() const;
+
+    /**
+     * @brief Returns the position of each dof on the lattice.
+     *
+     * @param lattice_dof_handler DoFHandler on the mesh of the lattice
+     * @return std::vector<unsigned int> The entry c + dim * v for each dof,
+     *         where c is its component and v the index of its vertex (see
+     *         MyTools::get_lattice_index() with get_lattice_intervals())
+     */
+    std::vector<unsigned int>
+    get_lattice_entries(const DoFHandler<dim> &lattice_dof_handler) const;
+
+    /**
+     * @brief Returns the values of the basis functions at the vertices of
+     *        the lattice of get_lattice_intervals().
+     *
+     * @param values Values in the layout of get_basis_values_on_lattice()
+     *
+     * The fine mesh must be that of the lattice.
+     */
+    void
+    get_basis_values_on_mesh_lattice(std::vector<double> &values) const;
+
+    /**
+     * @brief Sets the basis functions from their values on the lattice.
+     *
+     * @param values Values of the basis functions on the lattice of
+     *               get_lattice_intervals() in the layout of
+     *               get_basis_values_on_lattice()
+     *
+     * The fine mesh and its dofs must already exist.
+     */
+    void
+    set_basis_values_on_lattice(const double *values);
+
     /**
      * @brief Sets up the system.
      *
@@ -196,6 +490,47 @@ namespace Elasticity
     void
     assemble_system();
 
+    /**
+     * @brief Assembles the system with the basis functions of the cells of
+     *        the intermediate mesh.
+     *
+     * Instead of the fine-scale integrals, the #assembled_cell_matrix and
+     * the #assembled_cell_rhs are assembled from the element matrices and
+     * right-hand sides of an ElaBasis object for each cell of the
+     * intermediate mesh. Their basis functions are kept in
+     * #sub_basis_values for prolongate_basis().
+     *
+     * @param progress_callback Passed on to the run() of each intermediate
+     *                          cell
+     */
+    void
+    assemble_system_multilevel(
+      const std::function<void()> &progress_callback);
+
+    /**
+     * @brief Moves the basis functions from the intermediate mesh to the
+     *        fine mesh.
+     *
+     * The intermediate mesh is refined to the fine mesh of the cell, and the
+     * basis functions are evaluated with the basis functions of the
+     * intermediate cells at its vertices.
+     */
+    void
+    prolongate_basis();
+
+    /**
+     * @brief Refines the fine mesh adaptively.
+     *
+     * @return bool Whether any cell was refined
+     *
+     * The cells are chosen according to ParametersBasis::refinement. No cell
+     * is refined beyond ParametersBasis::n_refine refinements, and the mesh
+     * is kept within ParametersBasis::dof_budget. With the Kelly estimate,
+     * the basis functions must have been solved on the current mesh.
+     */
+    bool
+    refine_grid();
+
     /**
      * @brief Solves the problem at a quadrature point.
      *
@@ -207,14 +542,45 @@ namespace Elasticity
      *
      * In #parameters_basis, it can be specified if a direct
      * or iterative (CG-method with SSOR preconditioner) shall
-     * be used.
+     * be used. With ParametersBasis::single_precision, the iterative
+     * solver runs on the #single_precision_matrix that
+     * solve_basis_problems() builds once for all basis functions.
      */
     void
     solve(unsigned int q_point);
 
+    /**
+     * @brief Solves the problems of all basis functions with their
+     *        constraints.
+     *
+     * With ParametersBasis::single_precision, the condensed matrix is only
+     * stored in single precision next to the #assembled_cell_matrix, which
+     * the projection needs anyway.
+     *
+     * @param progress_callback Called after each basis function if not empty
+     */
+    void
+    solve_basis_problems(const std::function<void()> &progress_callback);
+
+    /**
+     * @brief Returns the tolerance of the iterative solver.
+     *
+     * @return double Absolute tolerance for the residual of #system_rhs
+     *
+     * The tolerance is chosen according to
+     * ParametersBasis::tolerance_policy. Solving the cell problems more
+     * accurately than the coarse discretization does not improve the
+     * multiscale solution.
+     */
+    double
+    get_solver_tolerance() const;
+
     /**
      * @brief Assembles the local contribution to the global system matrix
      *        in ElaMs.
+     *
+     * With GlobalParameters::affine_decomposition, the contributions of
+     * both Lamé parameters are also projected separately.
      */
     void
     assemble_global_element_matrix();
@@ -225,30 +591,37 @@ namespace Elasticity
     void
     output_basis();
 
-    MPI_Comm                                          mpi_communicator;
-    typename Triangulation<dim>::active_cell_iterator first_cell;
-    Triangulation<dim>                                triangulation;
-    FESystem<dim>                                     fe;
-    DoFHandler<dim>                                   dof_handler;
-    std::vector<AffineConstraints<double>>            constraints_vector;
-    std::vector<Point<dim>>                           corner_points;
-    std::vector<Vector<double>>                       solution_vector;
-    SparsityPattern                                   sparsity_pattern;
-    Vector<double>                                    assembled_cell_rhs;
-    SparseMatrix<double>                              assembled_cell_matrix;
-    Vector<double>                                    global_element_rhs;
-    FullMatrix<double>                                global_element_matrix;
-    std::vector<double>                               global_weights;
-    Vector<double>                                    system_rhs;
-    SparseMatrix<double>                              system_matrix;
-    Vector<double>                                    global_solution;
-    const CellId                                      global_cell_id;
-    const unsigned int                                local_subdomain;
-    const ParametersBasis                             parameters_basis;
-    const GlobalParameters<dim>                       global_parameters;
-    std::string                                       filename;
-    BasisFun::BasisQ1<dim>                            basis_q1;
-    const unsigned int                                cycle;
+    MPI_Comm                                           mpi_communicator;
+    typename Triangulation<dim>::active_cell_iterator  first_cell;
+    Triangulation<dim>                                 triangulation;
+    FESystem<dim>                                      fe;
+    DoFHandler<dim>                                    dof_handler;
+    std::vector<AffineConstraints<double>>             constraints_vector;
+    std::vector<Point<dim>>                            corner_points;
+    std::vector<Vector<double>>                        solution_vector;
+    SparsityPattern                                    sparsity_pattern;
+    Vector<double>                                     assembled_cell_rhs;
+    SparseMatrix<double>                               assembled_cell_matrix;
+    SparseMatrix<double>                               assembled_matrix_lambda;
+    SparseMatrix<double>                               assembled_matrix_mu;
+    Vector<double>                                     global_element_rhs;
+    FullMatrix<double>                                 global_element_matrix;
+    FullMatrix<double>                                 element_matrix_lambda;
+    FullMatrix<double>                                 element_matrix_mu;
+    std::vector<double>                                global_weights;
+    Vector<double>                                     system_rhs;
+    SparseMatrix<double>                               system_matrix;
+    SparseMatrix<float>                                single_precision_matrix;
+    std::vector<std::vector<double>>                   sub_basis_values;
+    Vector<double>                                     global_solution;
+    const CellId                                       global_cell_id;
+    const unsigned int                                 local_subdomain;
+    const ParametersBasis                              parameters_basis;
+    const std::shared_ptr<const GlobalParameters<dim>> global_parameters;
+    std::string                                        filename;
+    BasisFun::BasisQ1<dim>                             basis_q1;
+    const unsigned int                                 cycle;
+    const LameScaling                                  lame_scaling;
   };
 } // namespace Elasticity
 
@@ -8,6 +8,87 @@ namespace Elasticity
 {
   using namespace dealii;
 
+  /****************************************************************************/
+  /* Cell matrices of the fine-scale problems */
+
+  template <int dim>
+  ElaLocalAssembler<dim>::ElaLocalAssembler(
+    const FiniteElement<dim>                           &fe,
+    const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+    const LameScaling                                  &lame_scaling)
+    : cell_matrix(fe.n_dofs_per_cell(), fe.n_dofs_per_cell())
+    , matrix_lambda(fe.n_dofs_per_cell(), fe.n_dofs_per_cell())
+    , matrix_mu(fe.n_dofs_per_cell(), fe.n_dofs_per_cell())
+    , cell_rhs(fe.n_dofs_per_cell())
+    , quadrature_formula(fe.degree + 1)
+    , fe_values(fe,
+                quadrature_formula,
+                update_values | update_gradients | update_quadrature_points |
+                  update_JxW_values)
+    , global_parameters(global_parameters)
+    , lame_scaling(lame_scaling)
+    , body_force(1.)
+    , lambda_values(quadrature_formula.size())
+    , mu_values(quadrature_formula.size())
+    , body_force_values(quadrature_formula.size(), Vector<double>(dim))
+  {}
+
+
+  template <int dim>
+  void
+  ElaLocalAssembler<dim>::assemble(
+    const typename DoFHandler<dim>::active_cell_iterator &cell)
+  {
+    const FiniteElement<dim> &fe            = fe_values.get_fe();
+    const unsigned int        dofs_per_cell = fe.n_dofs_per_cell();
+    const unsigned int        n_q_points    = quadrature_formula.size();
+
+    matrix_lambda = 0.;
+    matrix_mu     = 0.;
+    cell_rhs      = 0.;
+    fe_values.reinit(cell);
+    global_parameters->lambda.value_list(fe_values.get_quadrature_points(),
+                                         lambda_values);
+    global_parameters->mu.value_list(fe_values.get_quadrature_points(),
+                                     mu_values);
+    body_force.vector_value_list(fe_values.get_quadrature_points(),
+                                 body_force_values);
+    for (unsigned int q_index = 0; q_index < n_q_points; ++q_index)
+      {
+        for (unsigned int i = 0; i < dofs_per_cell; ++i)
+          {
+            const unsigned int component_i =
+              fe.system_to_component_index(i).first;
+            for (unsigned int j = 0; j < dofs_per_cell; ++j)
+              {
+                const unsigned int component_j =
+                  fe.system_to_component_index(j).first;
+                matrix_lambda(i, j) +=
+                  fe_values.shape_grad(i, q_index)[component_i] *
+                  fe_values.shape_grad(j, q_index)[component_j] *
+                  lambda_values[q_index] * fe_values.JxW(q_index);
+                matrix_mu(i, j) +=
+                  ((fe_values.shape_grad(i, q_index)[component_j] *
+                    fe_values.shape_grad(j, q_index)[component_i]) +
+                   ((component_i == component_j) ?
+                      (fe_values.shape_grad(i, q_index) *
+                       fe_values.shape_grad(j, q_index)) :
+                      0)) *
+                  mu_values[q_index] * fe_values.JxW(q_index);
+              }
+            cell_rhs(i) +=
+              fe_values.shape_value_component(i, q_index, component_i) *
+              body_force_values[q_index][component_i] *
+              fe_values.JxW(q_index);
+          }
+      }
+    cell_matrix.equ(lame_scaling.lambda,
+                    matrix_lambda,
+                    lame_scaling.mu,
+                    matrix_mu);
+  }
+
+
   /****************************************************************************/
   /* Class for the fine scale part of the multiscale implementation for
      linear elasticity problems */
@@ -15,13 +96,14 @@ namespace Elasticity
   // The constructor
   template <int dim>
   ElaBasis<dim>::ElaBasis(
-    typename Triangulation<dim>::active_cell_iterator &global_cell,
-    typename Triangulation<dim>::active_cell_iterator &first_cell,
-    unsigned int                                       local_subdomain,
-    MPI_Comm                                           mpi_communicator,
-    const ParametersBasis                             &parameters_basis,
-    const GlobalParameters<dim>                       &global_parameters,
-    const unsigned int                                 cycle)
+    typename Triangulation<dim>::active_cell_iterator  &global_cell,
+    typename Triangulation<dim>::active_cell_iterator  &first_cell,
+    unsigned int                                        local_subdomain,
+    MPI_Comm                                            mpi_communicator,
+    const ParametersBasis                              &parameters_basis,
+    const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+    const unsigned int                                  cycle,
+    const LameScaling                                  &lame_scaling)
     : mpi_communicator(mpi_communicator)
     , first_cell(first_cell)
     , triangulation()
@@ -39,6 +121,7 @@ namespace Elasticity
     , global_parameters(global_parameters)
     , basis_q1(global_cell)
     , cycle(cycle)
+    , lame_scaling(lame_scaling)
   {
     // set corner points
     for (unsigned int vertex_n = 0;
@@ -50,6 +133,41 @@ namespace Elasticity
   }
 
 
+  template <int dim>
+  ElaBasis<dim>::ElaBasis(
+    const std::vector<Point<dim>>                      &corner_points,
+    const CellId                                       &global_cell_id,
+    MPI_Comm                                            mpi_communicator,
+    const ParametersBasis                              &parameters_basis,
+    const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+    const unsigned int                                  cycle,
+    const LameScaling                                  &lame_scaling)
+    : mpi_communicator(mpi_communicator)
+    , first_cell()
+    , triangulation()
+    , fe(FE_Q<dim>(1), dim)
+    , dof_handler(triangulation)
+    , constraints_vector(fe.dofs_per_cell)
+    , corner_points(corner_points)
+    , solution_vector(fe.dofs_per_cell)
+    , global_element_rhs(fe.dofs_per_cell)
+    , global_element_matrix(fe.dofs_per_cell, fe.dofs_per_cell)
+    , global_weights(fe.dofs_per_cell)
+    , global_cell_id(global_cell_id)
+    , local_subdomain(Utilities::MPI::this_mpi_process(mpi_communicator))
+    , parameters_basis(parameters_basis)
+    , global_parameters(global_parameters)
+    , basis_q1(corner_points)
+    , cycle(cycle)
+    , lame_scaling(lame_scaling)
+  {
+    // There is no first cell to compare with, so the output must be off.
+    Assert(parameters_basis.prevent_output,
+           ExcMessage("The basis functions of a cell of another processor "
+                      "cannot be written."));
+  }
+
+
   template <int dim>
   ElaBasis<dim>::ElaBasis(const ElaBasis<dim> &other)
     : mpi_communicator(other.mpi_communicator)
@@ -69,9 +187,101 @@ namespace Elasticity
     , global_parameters(other.global_parameters)
     , basis_q1(other.basis_q1)
     , cycle(other.cycle)
+    , lame_scaling(other.lame_scaling)
   {}
 
 
+  template <int dim>
+  void
+  ElaBasis<dim>::make_grid(const unsigned int n_refine)
+  {
+    GridGenerator::general_cell(triangulation,
+                                corner_points,
+                                /* colorize faces */ false);
+    triangulation.refine_global(n_refine);
+  }
+
+
+  template <int dim>
+  void
+  ElaBasis<dim>::make_anisotropic_grid()
+  {
+    const RefinementCase<dim> refinement_case =
+      get_anisotropic_refinement_case();
+
+    if (refinement_case == RefinementCase<dim>::no_refinement)
+      {
+        make_grid(parameters_basis.n_refine);
+        return;
+      }
+
+    GridGenerator::general_cell(triangulation,
+                                corner_points,
+                                /* colorize faces */ false);
+
+    // All cells are cut in the same way, so there are no hanging nodes.
+    for (unsigned int i = 0; i < parameters_basis.n_refine; ++i)
+      {
+        for (const auto &cell : triangulation.active_cell_iterators())
+          cell->set_refine_flag(refinement_case);
+        triangulation.execute_coarsening_and_refinement();
+      }
+  }
+
+
+  template <int dim>
+  RefinementCase<dim>
+  ElaBasis<dim>::get_anisotropic_refinement_case() const
+  {
+    const std::map<std::string, bool> &material_structure =
+      global_parameters->material_structure;
+
+    RefinementCase<dim> refinement_case = RefinementCase<dim>::no_refinement;
+    if (material_structure.at("horizontal layers") ||
+        material_structure.at("oscillations"))
+      refinement_case = refinement_case | RefinementCase<dim>::cut_axis(0);
+    if (material_structure.at("y-layers"))
+      refinement_case = refinement_case | RefinementCase<dim>::cut_axis(1);
+    if (material_structure.at("vertical layers"))
+      refinement_case =
+        refinement_case | RefinementCase<dim>::cut_axis(dim - 1);
+
+    return refinement_case;
+  }
+
+
+  template <int dim>
+  bool
+  ElaBasis<dim>::is_multilevel() const
+  {
+    return (parameters_basis.n_levels > 1 && parameters_basis.n_refine > 1);
+  }
+
+
+  template <int dim>
+  std::vector<unsigned int>
+  ElaBasis<dim>::get_lattice_intervals() const
+  {
+    std::vector<unsigned int> n_intervals(
+      dim, Utilities::pow(2, parameters_basis.n_refine));
+
+    if (is_multilevel() || parameters_basis.refinement != "anisotropic")
+      return n_intervals;
+
+    const RefinementCase<dim> refinement_case =
+      get_anisotropic_refinement_case();
+    if (refinement_case == RefinementCase<dim>::no_refinement)
+      return n_intervals;
+
+    for (unsigned int d = 0; d < dim; ++d)
+      if ((refinement_case & RefinementCase<dim>::cut_axis(d)) ==
+          RefinementCase<dim>::no_refinement)
+        n_intervals[d] = 1;
+
+    return n_intervals;
+  }
+
+
   template <int dim>
   void
   ElaBasis<dim>::setup_system()
@@ -106,8 +316,11 @@ namespace Elasticity
     sparsity_pattern.copy_from(dsp);
 
     assembled_cell_matrix.reinit(sparsity_pattern);
-    system_matrix.reinit(sparsity_pattern);
-
+    if (global_parameters->affine_decomposition)
+      {
+        assembled_matrix_lambda.reinit(sparsity_pattern);
+        assembled_matrix_mu.reinit(sparsity_pattern);
+      }
     for (unsigned int q_index = 0; q_index < fe.dofs_per_cell; ++q_index)
       {
         solution_vector[q_index].reinit(dof_handler.n_dofs());
@@ -122,65 +335,17 @@ namespace Elasticity
   void
   ElaBasis<dim>::assemble_system()
   {
-    const QGauss<dim>  quadrature_formula(fe.degree + 1);
-    FEValues<dim>      fe_values(fe,
-                            quadrature_formula,
-                            update_values | update_gradients |
-                              update_quadrature_points | update_JxW_values);
     const unsigned int dofs_per_cell = fe.n_dofs_per_cell();
-    const unsigned int n_q_points    = quadrature_formula.size();
-
-    BodyForce<dim>              body_force(global_parameters.rho);
-    std::vector<Vector<double>> body_force_values(n_q_points);
-    for (unsigned int i = 0; i < n_q_points; ++i)
-      body_force_values[i].reinit(dim);
-    std::vector<double> lambda_values(n_q_points), mu_values(n_q_points);
 
-    FullMatrix<double> local_cell_matrix(dofs_per_cell, dofs_per_cell);
-    Vector<double>     local_cell_rhs(dofs_per_cell);
+    ElaLocalAssembler<dim> local_assembler(fe,
+                                           global_parameters,
+                                           lame_scaling);
 
     std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
     for (const auto &cell : dof_handler.active_cell_iterators())
       {
-        local_cell_matrix = 0.;
-        local_cell_rhs    = 0.;
-        fe_values.reinit(cell);
-        global_parameters.lambda.value_list(fe_values.get_quadrature_points(),
-                                            lambda_values);
-        global_parameters.mu.value_list(fe_values.get_quadrature_points(),
-                                        mu_values);
-        body_force.vector_value_list(fe_values.get_quadrature_points(),
-                                     body_force_values);
-        for (unsigned int q_index = 0; q_index < n_q_points; ++q_index)
-          {
-            for (unsigned int i = 0; i < dofs_per_cell; ++i)
-              {
-                const unsigned int component_i =
-                  fe.system_to_component_index(i).first;
-                for (unsigned int j = 0; j < dofs_per_cell; ++j)
-                  {
-                    const unsigned int component_j =
-                      fe.system_to_component_index(j).first;
-                    local_cell_matrix(i, j) +=
-                      ((fe_values.shape_grad(i, q_index)[component_i] *
-                        fe_values.shape_grad(j, q_index)[component_j] *
-                        lambda_values[q_index]) +
-                       (fe_values.shape_grad(i, q_index)[component_j] *
-                        fe_values.shape_grad(j, q_index)[component_i] *
-                        mu_values[q_index]) +
-                       ((component_i == component_j) ?
-                          (fe_values.shape_grad(i, q_index) *
-                           fe_values.shape_grad(j, q_index) *
-                           mu_values[q_index]) :
-                          0)) *
-                      fe_values.JxW(q_index);
-                  }
-                local_cell_rhs(i) +=
-                  fe_values.shape_value_component(i, q_index, component_i) *
-                  body_force_values[q_index][component_i] *
-                  fe_values.JxW(q_index);
-              }
-          }
+        local_assembler.assemble(cell);
+
         cell->get_dof_indices(local_dof_indices);
         for (unsigned int i = 0; i < dofs_per_cell; ++i)
           {
@@ -188,14 +353,83 @@ namespace Elasticity
               {
                 assembled_cell_matrix.add(local_dof_indices[i],
                                           local_dof_indices[j],
-                                          local_cell_matrix(i, j));
+                                          local_assembler.cell_matrix(i, j));
               }
-            assembled_cell_rhs(local_dof_indices[i]) += local_cell_rhs(i);
+            if (global_parameters->affine_decomposition)
+              for (unsigned int j = 0; j < dofs_per_cell; ++j)
+                {
+                  assembled_matrix_lambda.add(
+                    local_dof_indices[i],
+                    local_dof_indices[j],
+                    local_assembler.matrix_lambda(i, j));
+                  assembled_matrix_mu.add(local_dof_indices[i],
+                                          local_dof_indices[j],
+                                          local_assembler.matrix_mu(i, j));
+                }
+            assembled_cell_rhs(local_dof_indices[i]) +=
+              local_assembler.cell_rhs(i);
           }
       }
   }
 
 
+  template <int dim>
+  void
+  ElaBasis<dim>::assemble_system_multilevel(
+    const std::function<void()> &progress_callback)
+  {
+    const unsigned int dofs_per_cell = fe.n_dofs_per_cell();
+
+    // The cells of the intermediate mesh are refined to the fine mesh of
+    // this cell and use the same parameters with one level less.
+    ParametersBasis sub_parameters_basis(parameters_basis);
+    sub_parameters_basis.n_refine =
+      parameters_basis.n_refine - (triangulation.n_levels() - 1);
+    sub_parameters_basis.n_levels       = parameters_basis.n_levels - 1;
+    sub_parameters_basis.prevent_output = true;
+    sub_parameters_basis.verbose        = false;
+
+    sub_basis_values.resize(triangulation.n_active_cells());
+
+    std::vector<Point<dim>> cell_corner_points(
+      GeometryInfo<dim>::vertices_per_cell);
+    std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      {
+        for (unsigned int vertex_n = 0;
+             vertex_n < GeometryInfo<dim>::vertices_per_cell;
+             ++vertex_n)
+          cell_corner_points[vertex_n] = cell->vertex(vertex_n);
+
+        // The vertices of the cell are passed in their order, so the basis
+        // functions of the cell are numbered like its dofs.
+        ElaBasis<dim> sub_basis(cell_corner_points,
+                                global_cell_id,
+                                mpi_communicator,
+                                sub_parameters_basis,
+                                global_parameters,
+                                cycle,
+                                lame_scaling);
+        sub_basis.run(progress_callback);
+        sub_basis.get_basis_values_on_lattice(
+          sub_basis_values[cell->active_cell_index()]);
+
+        cell->get_dof_indices(local_dof_indices);
+        assembled_cell_matrix.add(local_dof_indices,
+                                  sub_basis.get_global_element_matrix());
+        if (global_parameters->affine_decomposition)
+          {
+            assembled_matrix_lambda.add(local_dof_indices,
+                                        sub_basis.get_element_matrix_lambda());
+            assembled_matrix_mu.add(local_dof_indices,
+                                    sub_basis.get_element_matrix_mu());
+          }
+        assembled_cell_rhs.add(local_dof_indices,
+                               sub_basis.get_global_element_rhs());
+      }
+  }
+
+
   template <int dim>
   void
   ElaBasis<dim>::solve(unsigned int q_point)
@@ -206,15 +440,52 @@ namespace Elasticity
         A_inv.initialize(system_matrix);
         A_inv.vmult(solution_vector[q_point], system_rhs);
 
+        constraints_vector[q_point].distribute(solution_vector[q_point]);
+      }
+    else if (parameters_basis.single_precision)
+      {
+        // The basis functions only need to be as accurate as the coarse
+        // discretization, so the tolerance is above the float round-off.
+        Vector<float> single_precision_rhs(system_rhs);
+        Vector<float> single_precision_solution(dof_handler.n_dofs());
+
+        const double     solver_tolerance =
+          std::max(get_solver_tolerance(), 1e-5 * system_rhs.l2_norm());
+        ReductionControl solver_control(
+          /* n_max_iter */ dof_handler.n_dofs(),
+          solver_tolerance,
+          parameters_basis.solver_reduction,
+          /* log_history */ false,
+          /* log_result */ false);
+
+        SolverCG<Vector<float>> solver(solver_control);
+
+        PreconditionSSOR<SparseMatrix<float>> preconditioner;
+        preconditioner.initialize(single_precision_matrix, 1.6);
+
+        try
+          {
+            solver.solve(single_precision_matrix,
+                         single_precision_solution,
+                         single_precision_rhs,
+                         preconditioner);
+          }
+        catch (std::exception &e)
+          {
+            Assert(false, ExcMessage(e.what()));
+          }
+
+        solution_vector[q_point] = single_precision_solution;
         constraints_vector[q_point].distribute(solution_vector[q_point]);
       }
     else
       {
-        unsigned int  n_iterations     = dof_handler.n_dofs();
-        const double  solver_tolerance = 1e-8 * assembled_cell_rhs.l2_norm();
-        SolverControl solver_control(
+        unsigned int     n_iterations     = dof_handler.n_dofs();
+        const double     solver_tolerance = get_solver_tolerance();
+        ReductionControl solver_control(
           /* n_max_iter */ n_iterations,
           solver_tolerance,
+          parameters_basis.solver_reduction,
           /* log_history */ false,
           /* log_result */ false);
 
@@ -245,6 +516,87 @@ namespace Elasticity
   }
 
 
+  template <int dim>
+  double
+  ElaBasis<dim>::get_solver_tolerance() const
+  {
+    // The constraints are condensed into system_rhs, so its norm is the
+    // scale of the residual that CG reduces.
+    const double rhs_norm = system_rhs.l2_norm();
+
+    if (parameters_basis.tolerance_policy == "coarse error")
+      {
+        // For Q1 elements the relative energy error of the coarse solution
+        // is of the order H/L.
+        const double coarse_diameter =
+          corner_points.front().distance(corner_points.back());
+        const double domain_diameter =
+          global_parameters->init_p1.distance(global_parameters->init_p2);
+
+        return parameters_basis.safety_factor * coarse_diameter /
+               domain_diameter * rhs_norm;
+      }
+
+    return parameters_basis.solver_tolerance * rhs_norm;
+  }
+
+
+  template <int dim>
+  void
+  ElaBasis<dim>::solve_basis_problems(
+    const std::function<void()> &progress_callback)
+  {
+    const bool single_precision =
+      (!parameters_basis.direct_solver && parameters_basis.single_precision);
+
+    // The constraints of the basis functions only differ in their boundary
+    // values, so the condensed matrix is the same for all of them. In
+    // single precision, it is built once and no condensed double matrix
+    // exists at all. AffineConstraints only condenses matrices of its own
+    // number type.
+    if (single_precision)
+      {
+        AffineConstraints<float> single_precision_constraints;
+        single_precision_constraints.copy_from(constraints_vector[0]);
+
+        single_precision_matrix.reinit(sparsity_pattern);
+        single_precision_matrix.copy_from(assembled_cell_matrix);
+        single_precision_constraints.condense(single_precision_matrix);
+      }
+
+    for (unsigned int q_index = 0; q_index < fe.dofs_per_cell; ++q_index)
+      {
+        system_rhs.reinit(solution_vector[q_index].size());
+
+        if (single_precision)
+          {
+            // The boundary values g are lifted to the right-hand side -A g.
+            // The solution is then zero on the constrained dofs and solve()
+            // adds g with distribute().
+            Vector<double> boundary_values(system_rhs.size());
+            constraints_vector[q_index].distribute(boundary_values);
+            assembled_cell_matrix.vmult(system_rhs, boundary_values);
+            system_rhs *= -1.;
+            constraints_vector[q_index].condense(system_rhs);
+          }
+        else
+          {
+            system_matrix.reinit(sparsity_pattern);
+            system_matrix.copy_from(assembled_cell_matrix);
+            constraints_vector[q_index].condense(system_matrix, system_rhs);
+          }
+
+        solve(q_index);
+
+        if (progress_callback)
+          progress_callback();
+      }
+
+    system_matrix.clear();
+    single_precision_matrix.clear();
+  }
+
+
   template <int dim>
   void
   ElaBasis<dim>::assemble_global_element_matrix()
@@ -252,6 +604,13 @@ namespace Elasticity
     // First, reset.
     global_element_matrix = 0;
 
+    const bool affine_decomposition = global_parameters->affine_decomposition;
+    if (affine_decomposition)
+      {
+        element_matrix_lambda.reinit(fe.dofs_per_cell, fe.dofs_per_cell);
+        element_matrix_mu.reinit(fe.dofs_per_cell, fe.dofs_per_cell);
+      }
+
     // Get lengths of tmp vectors for assembly
     const unsigned int dofs_per_cell = fe.dofs_per_cell;
 
@@ -277,6 +636,15 @@ namespace Elasticity
             // global_element_matrix = test_vec*tmp
             global_element_matrix(i_test, i_trial) += (test_vec * tmp);
 
+            if (affine_decomposition)
+              {
+                assembled_matrix_lambda.vmult(tmp, trial_vec);
+                element_matrix_lambda(i_test, i_trial) += (test_vec * tmp);
+
+                assembled_matrix_mu.vmult(tmp, trial_vec);
+                element_matrix_mu(i_test, i_trial) += (test_vec * tmp);
+              }
+
             // reset
             tmp = 0;
           } // end for i_trial
@@ -289,7 +657,159 @@ namespace Elasticity
 
   template <int dim>
   void
-  ElaBasis<dim>::run()
+  ElaBasis<dim>::prolongate_basis()
+  {
+    const unsigned int dofs_per_cell = fe.dofs_per_cell;
+    const unsigned int n_intervals =
+      Utilities::pow(2, parameters_basis.n_refine);
+    const unsigned int n_sub_refine =
+      parameters_basis.n_refine - (triangulation.n_levels() - 1);
+    const unsigned int n_sub_intervals = Utilities::pow(2, n_sub_refine);
+    const unsigned int n_sub_vertices =
+      Utilities::pow(n_sub_intervals + 1, dim);
+
+    const Point<dim> &p1 = corner_points[0];
+    const Point<dim> &p2 =
+      corner_points[GeometryInfo<dim>::vertices_per_cell - 1];
+
+    std::vector<double> values(Utilities::pow(n_intervals + 1, dim) * dim *
+                                 dofs_per_cell,
+                               0.);
+
+    std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      {
+        cell->get_dof_indices(local_dof_indices);
+
+        const std::vector<double> &cell_values =
+          sub_basis_values[cell->active_cell_index()];
+        const Point<dim> &lower = cell->vertex(0);
+        const Point<dim> &upper =
+          cell->vertex(GeometryInfo<dim>::vertices_per_cell - 1);
+
+        for (unsigned int s = 0; s < n_sub_vertices; ++s)
+          {
+            // The lattice of the cell is numbered with the x-direction
+            // running fastest.
+            Point<dim>   vertex;
+            unsigned int stride = 1;
+            for (unsigned int d = 0; d < dim; ++d)
+              {
+                const unsigned int lattice_coordinate =
+                  (s / stride) % (n_sub_intervals + 1);
+                vertex[d] = lower[d] + (upper[d] - lower[d]) *
+                                         lattice_coordinate / n_sub_intervals;
+                stride *= n_sub_intervals + 1;
+              }
+            const unsigned int vertex_index =
+              MyTools::get_lattice_index(vertex, p1, p2, n_intervals);
+
+            // Each basis function of this cell is a combination of the basis
+            // functions of the intermediate cell. Vertices on the faces of
+            // the intermediate cells get the same value from both sides.
+            for (unsigned int c = 0; c < dim; ++c)
+              {
+                const double *cell_entry =
+                  &cell_values[(c + dim * s) * dofs_per_cell];
+                double *entry =
+                  &values[(c + dim * vertex_index) * dofs_per_cell];
+                for (unsigned int q = 0; q < dofs_per_cell; ++q)
+                  {
+                    entry[q] = 0.;
+                    for (unsigned int i = 0; i < dofs_per_cell; ++i)
+                      entry[q] += solution_vector[q][local_dof_indices[i]] *
+                                  cell_entry[i];
+                  }
+              }
+          }
+      }
+    sub_basis_values.clear();
+
+    // The refined intermediate mesh is the mesh of make_grid().
+    triangulation.refine_global(n_sub_refine);
+    dof_handler.distribute_dofs(fe);
+    set_basis_values_on_lattice(values.data());
+  }
+
+
+  template <int dim>
+  bool
+  ElaBasis<dim>::refine_grid()
+  {
+    // A mesh of quadrilaterals or hexahedra has about one vertex per cell,
+    // so the budget of dofs limits the number of cells.
+    const unsigned int max_n_cells =
+      (parameters_basis.dof_budget > 0 ?
+         parameters_basis.dof_budget / dim :
+         std::numeric_limits<unsigned int>::max());
+    if (triangulation.n_active_cells() >= max_n_cells)
+      return false;
+
+    Vector<float> indicators(triangulation.n_active_cells());
+    if (parameters_basis.refinement == "kelly")
+      {
+        // The estimates of all basis functions are added up.
+        Vector<float> basis_indicators(triangulation.n_active_cells());
+        for (unsigned int q_index = 0; q_index < fe.dofs_per_cell; ++q_index)
+          {
+            KellyErrorEstimator<dim>::estimate(
+              dof_handler,
+              QGauss<dim - 1>(fe.degree + 1),
+              std::map<types::boundary_id, const Function<dim> *>(),
+              solution_vector[q_index],
+              basis_indicators);
+            indicators += basis_indicators;
+          }
+      }
+    else
+      {
+        // The indicator is the relative variation of the Lamé parameters,
+        // so it vanishes inside a layer.
+        for (const auto &cell : triangulation.active_cell_iterators())
+          {
+            const std::vector<std::pair<double, double>> min_max =
+              MyTools::get_min_max_on_lattice<dim>(
+                {&global_parameters->lambda, &global_parameters->mu},
+                cell->vertex(0),
+                cell->vertex(GeometryInfo<dim>::vertices_per_cell - 1),
+                /* n_intervals */ 4);
+
+            for (const std::pair<double, double> &parameter_range : min_max)
+              indicators(cell->active_cell_index()) = std::max(
+                indicators(cell->active_cell_index()),
+                static_cast<float>(1. - parameter_range.first /
+                                          parameter_range.second));
+          }
+      }
+
+    // All cells in which the material varies are candidates.
+    const double fraction = (parameters_basis.refinement == "kelly" ?
+                               parameters_basis.refinement_fraction :
+                               1.);
+    GridRefinement::refine_and_coarsen_fixed_number(
+      triangulation, indicators, fraction, 0., max_n_cells);
+
+    bool refine = false;
+    for (const auto &cell : triangulation.active_cell_iterators())
+      if (cell->refine_flag_set())
+        {
+          if (cell->level() >= static_cast<int>(parameters_basis.n_refine) ||
+              indicators(cell->active_cell_index()) == 0.)
+            cell->clear_refine_flag();
+          else
+            refine = true;
+        }
+
+    if (refine)
+      triangulation.execute_coarsening_and_refinement();
+
+    return refine;
+  }
+
+
+  template <int dim>
+  void
+  ElaBasis<dim>::run(const std::function<void()> &progress_callback)
   {
     Timer timer;
 
@@ -303,35 +823,57 @@ namespace Elasticity
         std::cout << "	Solving for basis in cell   "
                   << global_cell_id.to_string() << "   [machine: " << proc_name
                   << " | rank: "
-                  << Utilities::MPI::this_mpi_process(MPI_COMM_WORLD)
+                  << Utilities::MPI::this_mpi_process(mpi_communicator)
                   << "]   ..... ";
       }
 
     timer.restart();
 
-    GridGenerator::general_cell(triangulation,
-                                corner_points,
-                                /* colorize faces */ false);
-    triangulation.refine_global(global_parameters.fine_refinements);
+    // With several levels, the basis functions are first computed on an
+    // intermediate mesh with half of the refinements.
+    const bool multilevel = is_multilevel();
 
-    setup_system();
+    // Adaptive meshes start from one refinement.
+    const std::string &refinement = parameters_basis.refinement;
+    const bool         adaptive =
+      (!multilevel && (refinement == "material" || refinement == "kelly"));
+
+    if (multilevel)
+      make_grid(parameters_basis.n_refine / 2);
+    else if (refinement == "anisotropic")
+      make_anisotropic_grid();
+    else
+      make_grid(adaptive ? 1 : parameters_basis.n_refine);
 
-    assemble_system();
+    // The material does not depend on the basis functions, so the mesh is
+    // refined before anything is solved.
+    if (adaptive && refinement == "material")
+      while (refine_grid())
+        {
+        }
 
-    for (unsigned int q_index = 0; q_index < fe.dofs_per_cell; ++q_index)
-      {
-        system_rhs.reinit(solution_vector[q_index].size());
-        system_matrix.reinit(sparsity_pattern);
+    setup_system();
 
-        system_matrix.copy_from(assembled_cell_matrix);
+    if (multilevel)
+      assemble_system_multilevel(progress_callback);
+    else
+      assemble_system();
 
-        constraints_vector[q_index].condense(system_matrix, system_rhs);
+    solve_basis_problems(progress_callback);
 
-        solve(q_index);
-      }
+    if (adaptive && refinement == "kelly")
+      while (refine_grid())
+        {
+          setup_system();
+          assemble_system();
+          solve_basis_problems(progress_callback);
+        }
 
     assemble_global_element_matrix();
 
+    if (multilevel)
+      prolongate_basis();
+
     if (!parameters_basis.prevent_output)
       if (global_cell_id == first_cell->id())
         output_basis();
@@ -339,6 +881,7 @@ namespace Elasticity
     {
       // Free memory as much as possible
       system_matrix.clear();
+      single_precision_matrix.clear();
       for (unsigned int i = 0; i < GeometryInfo<3>::vertices_per_cell; ++i)
         {
           constraints_vector[i].clear();
@@ -363,6 +906,28 @@ namespace Elasticity
   }
 
 
+  template <int dim>
+  const FullMatrix<double> &
+  ElaBasis<dim>::get_element_matrix_lambda() const
+  {
+    Assert(global_parameters->affine_decomposition,
+           ExcMessage("The affine decomposition is not enabled."));
+
+    return element_matrix_lambda;
+  }
+
+
+  template <int dim>
+  const FullMatrix<double> &
+  ElaBasis<dim>::get_element_matrix_mu() const
+  {
+    Assert(global_parameters->affine_decomposition,
+           ExcMessage("The affine decomposition is not enabled."));
+
+    return element_matrix_mu;
+  }
+
+
   template <int dim>
   const Vector<double> &
   ElaBasis<dim>::get_global_element_rhs() const
@@ -396,6 +961,268 @@ namespace Elasticity
   }
 
 
+  template <int dim>
+  void
+  ElaBasis<dim>::append_global_solution_at_quadrature_points(
+    std::vector<Point<dim>>     &points,
+    std::vector<double>         &JxW,
+    std::vector<Tensor<1, dim>> &values,
+    std::vector<Tensor<2, dim>> &gradients) const
+  {
+    Assert(global_solution.size() == dof_handler.n_dofs(),
+           ExcMessage("The global weights are not set."));
+
+    const QGauss<dim> quadrature_formula(fe.degree + 1);
+    const unsigned int n_q_points = quadrature_formula.size();
+
+    FEValues<dim> fe_values(fe,
+                            quadrature_formula,
+                            update_values | update_gradients |
+                              update_quadrature_points | update_JxW_values);
+
+    const FEValuesExtractors::Vector displacements(0);
+    std::vector<Tensor<1, dim>>      cell_values(n_q_points);
+    std::vector<Tensor<2, dim>>      cell_gradients(n_q_points);
+
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      {
+        fe_values.reinit(cell);
+        fe_values[displacements].get_function_values(global_solution,
+                                                     cell_values);
+        fe_values[displacements].get_function_gradients(global_solution,
+                                                        cell_gradients);
+
+        for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
+          {
+            points.push_back(fe_values.quadrature_point(q_point));
+            JxW.push_back(fe_values.JxW(q_point));
+            values.push_back(cell_values[q_point]);
+            gradients.push_back(cell_gradients[q_point]);
+          }
+      }
+  }
+
+
+  template <int dim>
+  std::vector<unsigned int>
+  ElaBasis<dim>::get_lattice_entries(
+    const DoFHandler<dim> &lattice_dof_handler) const
+  {
+    const std::vector<unsigned int> n_intervals = get_lattice_intervals();
+
+    const Point<dim> &p1 = corner_points[0];
+    const Point<dim> &p2 =
+      corner_points[GeometryInfo<dim>::vertices_per_cell - 1];
+
+    std::vector<unsigned int> entries(lattice_dof_handler.n_dofs());
+    std::vector<types::global_dof_index> local_dof_indices(fe.dofs_per_cell);
+    for (const auto &cell : lattice_dof_handler.active_cell_iterators())
+      {
+        cell->get_dof_indices(local_dof_indices);
+
+        for (unsigned int k = 0; k < fe.dofs_per_cell; ++k)
+          {
+            // For FE_Q(1), the base index of a dof is its vertex.
+            const std::pair<unsigned int, unsigned int> component_and_vertex =
+              fe.system_to_component_index(k);
+            const Point<dim> vertex =
+              cell->vertex(component_and_vertex.second);
+            entries[local_dof_indices[k]] =
+              component_and_vertex.first +
+              dim * MyTools::get_lattice_index(vertex, p1, p2, n_intervals);
+          }
+      }
+
+    return entries;
+  }
+
+
+  template <int dim>
+  void
+  ElaBasis<dim>::get_basis_values_on_lattice(std::vector<double> &values) const
+  {
+    const unsigned int dofs_per_cell = fe.dofs_per_cell;
+
+    // The uniformly refined mesh is its own lattice.
+    if (triangulation.n_active_cells() ==
+        Utilities::pow(2, dim * parameters_basis.n_refine))
+      {
+        get_basis_values_on_mesh_lattice(values);
+        return;
+      }
+
+    // Adaptive and anisotropic meshes are coarser than the uniformly
+    // refined one, so each cell contains a part of the lattice. The cells
+    // are boxes, so the lattice points of a cell have the same relative
+    // position in the reference cell. Vertices on the faces of the cells
+    // get the same value from both sides.
+    const unsigned int n_intervals =
+      Utilities::pow(2, parameters_basis.n_refine);
+
+    const Point<dim> &p1 = corner_points[0];
+    const Point<dim> &p2 =
+      corner_points[GeometryInfo<dim>::vertices_per_cell - 1];
+
+    values.assign(Utilities::pow(n_intervals + 1, dim) * dim * dofs_per_cell,
+                  0.);
+
+    std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      {
+        cell->get_dof_indices(local_dof_indices);
+
+        const Point<dim>     lower_corner = cell->vertex(0);
+        const Tensor<1, dim> diagonal =
+          cell->vertex(GeometryInfo<dim>::vertices_per_cell - 1) -
+          lower_corner;
+
+        std::vector<unsigned int> n_cell_intervals(dim);
+        unsigned int              n_cell_vertices = 1;
+        for (unsigned int d = 0; d < dim; ++d)
+          {
+            n_cell_intervals[d] = static_cast<unsigned int>(
+              std::round(diagonal[d] / (p2[d] - p1[d]) * n_intervals));
+            n_cell_vertices *= n_cell_intervals[d] + 1;
+          }
+
+        for (unsigned int s = 0; s < n_cell_vertices; ++s)
+          {
+            Point<dim>   unit_point, vertex = lower_corner;
+            unsigned int stride = 1;
+            for (unsigned int d = 0; d < dim; ++d)
+              {
+                const unsigned int lattice_coordinate =
+                  (s / stride) % (n_cell_intervals[d] + 1);
+                unit_point[d] =
+                  static_cast<double>(lattice_coordinate) / n_cell_intervals[d];
+                vertex[d] += unit_point[d] * diagonal[d];
+                stride *= n_cell_intervals[d] + 1;
+              }
+            const unsigned int vertex_index =
+              MyTools::get_lattice_index(vertex, p1, p2, n_intervals);
+
+            for (unsigned int c = 0; c < dim; ++c)
+              std::fill_n(&values[(c + dim * vertex_index) * dofs_per_cell],
+                          dofs_per_cell,
+                          0.);
+
+            for (unsigned int k = 0; k < dofs_per_cell; ++k)
+              {
+                const unsigned int component =
+                  fe.system_to_component_index(k).first;
+                const double shape_value =
+                  fe.shape_value_component(k, unit_point, component);
+
+                double *entry =
+                  &values[(component + dim * vertex_index) * dofs_per_cell];
+                for (unsigned int i = 0; i < dofs_per_cell; ++i)
+                  entry[i] += solution_vector[i][local_dof_indices[k]] *
+                              shape_value;
+              }
+          }
+      }
+  }
+
+
+  template <int dim>
+  void
+  ElaBasis<dim>::get_basis_values_on_mesh_lattice(
+    std::vector<double> &values) const
+  {
+    const unsigned int dofs_per_cell = fe.dofs_per_cell;
+
+    // Every vertex of the lattice carries dim dofs, so the lattice entries
+    // are a permutation of the dofs.
+    const std::vector<unsigned int> entries = get_lattice_entries(dof_handler);
+    values.assign(entries.size() * dofs_per_cell, 0.);
+
+    for (unsigned int dof = 0; dof < entries.size(); ++dof)
+      for (unsigned int i = 0; i < dofs_per_cell; ++i)
+        values[entries[dof] * dofs_per_cell + i] = solution_vector[i][dof];
+  }
+
+
+  template <int dim>
+  void
+  ElaBasis<dim>::set_basis_values_on_lattice(const double *values)
+  {
+    const unsigned int dofs_per_cell = fe.dofs_per_cell;
+
+    const std::vector<unsigned int> entries = get_lattice_entries(dof_handler);
+    for (unsigned int i = 0; i < dofs_per_cell; ++i)
+      {
+        solution_vector[i].reinit(dof_handler.n_dofs());
+        for (unsigned int dof = 0; dof < entries.size(); ++dof)
+          solution_vector[i][dof] = values[entries[dof] * dofs_per_cell + i];
+      }
+  }
+
+
+  template <int dim>
+  std::vector<double>
+  ElaBasis<dim>::pack_result() const
+  {
+    std::vector<const FullMatrix<double> *> matrices = {&global_element_matrix};
+    if (global_parameters->affine_decomposition)
+      {
+        matrices.push_back(&element_matrix_lambda);
+        matrices.push_back(&element_matrix_mu);
+      }
+    std::vector<double> result =
+      pack_element_system(global_element_rhs, matrices);
+
+    // The basis functions are packed on the lattice since the numbering of
+    // the dofs depends on the mesh that computed them. An anisotropic mesh
+    // is its own lattice, which is much smaller than the uniform one.
+    std::vector<double> basis_values;
+    if (parameters_basis.refinement == "anisotropic")
+      get_basis_values_on_mesh_lattice(basis_values);
+    else
+      get_basis_values_on_lattice(basis_values);
+    result.insert(result.end(), basis_values.begin(), basis_values.end());
+
+    return result;
+  }
+
+
+  template <int dim>
+  void
+  ElaBasis<dim>::unpack_result(const std::vector<double> &result)
+  {
+    if (!is_multilevel() && parameters_basis.refinement == "anisotropic")
+      make_anisotropic_grid();
+    else
+      make_grid(parameters_basis.n_refine);
+    dof_handler.distribute_dofs(fe);
+
+    const unsigned int dofs_per_cell = fe.dofs_per_cell;
+    const unsigned int n_matrices =
+      (global_parameters->affine_decomposition ? 3 : 1);
+    AssertDimension(result.size(),
+                    dofs_per_cell * (1 + n_matrices * dofs_per_cell +
+                                     dof_handler.n_dofs()));
+
+    auto entry = result.begin();
+    std::copy(entry, entry + dofs_per_cell, global_element_rhs.begin());
+    entry += dofs_per_cell;
+
+    global_element_matrix.fill(&*entry);
+    entry += dofs_per_cell * dofs_per_cell;
+    if (global_parameters->affine_decomposition)
+      {
+        element_matrix_lambda.reinit(dofs_per_cell, dofs_per_cell);
+        element_matrix_lambda.fill(&*entry);
+        entry += dofs_per_cell * dofs_per_cell;
+
+        element_matrix_mu.reinit(dofs_per_cell, dofs_per_cell);
+        element_matrix_mu.fill(&*entry);
+        entry += dofs_per_cell * dofs_per_cell;
+      }
+
+    set_basis_values_on_lattice(&*entry);
+  }
+
+
   template <int dim>
   void
   ElaBasis<dim>::output_basis()
@@ -432,7 +1259,7 @@ namespace Elasticity
 
         // add the linearized stress tensor to the output
         stress_proc_vector[n_basis] =
-          StressPostprocessor<dim>(n_basis, global_parameters);
+          StressPostprocessor<dim>(n_basis, global_parameters, lame_scaling);
         data_out.add_data_vector(basis_solution, stress_proc_vector[n_basis]);
       }
 
@@ -445,14 +1272,16 @@ namespace Elasticity
     filename += ".cell-" + global_cell_id.to_string();
     filename += ".vtu";
 
-    std::ofstream output("output/basis_output/" + filename);
+    std::ofstream output(global_parameters->output_directory +
+                         "basis_output/" + filename);
     data_out.write_vtu(output);
   }
 
 
   template <int dim>
   void
-  ElaBasis<dim>::output_global_solution_in_cell()
+  ElaBasis<dim>::output_global_solution_in_cell(const unsigned int material,
+                                                const unsigned int load_case)
   {
     DataOut<dim> data_out;
     data_out.attach_dof_handler(dof_handler);
@@ -473,7 +1302,8 @@ namespace Elasticity
     data_out.add_data_vector(global_solution, strain_postproc);
 
     // add the linearized stress tensor to the output
-    StressPostprocessor<dim> stress_postproc(global_parameters);
+    StressPostprocessor<dim> stress_postproc(
+      global_parameters, global_parameters->material_sweep[material]);
     data_out.add_data_vector(global_solution, stress_postproc);
 
     data_out.build_patches();
@@ -482,11 +1312,15 @@ namespace Elasticity
     filename = std::string("global_basis_output/");
     filename += std::string("basis_solution");
     filename += "." + Utilities::int_to_string(cycle, 2);
+    if (global_parameters->material_sweep.size() > 1)
+      filename += ".mt" + Utilities::int_to_string(material, 2);
+    if (global_parameters->load_cases.size() > 1)
+      filename += ".lc" + Utilities::int_to_string(load_case, 2);
     filename += "." + Utilities::int_to_string(local_subdomain, 5);
     filename += std::string(".cell-") + global_cell_id.to_string();
     filename += std::string(".vtu");
 
-    std::ofstream output("output/" + filename);
+    std::ofstream output(global_parameters->output_directory + filename);
     data_out.write_vtu(output);
   }
 
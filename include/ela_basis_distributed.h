@@ -0,0 +1,179 @@
+#ifndef _INCLUDE_ELA_BASIS_DISTRIBUTED_H_
+#define _INCLUDE_ELA_BASIS_DISTRIBUTED_H_
+
+#include <deal.II/base/conditional_ostream.h>
+#include <deal.II/base/index_set.h>
+#include <deal.II/base/mpi.h>
+#include <deal.II/base/quadrature_lib.h>
+#include <deal.II/base/timer.h>
+#include <deal.II/base/utilities.h>
+
+#include <deal.II/distributed/tria.h>
+
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/dofs/dof_tools.h>
+
+#include <deal.II/fe/fe_q.h>
+#include <deal.II/fe/fe_system.h>
+#include <deal.II/fe/fe_values.h>
+
+#include <deal.II/grid/grid_generator.h>
+#include <deal.II/grid/tria.h>
+
+#include <deal.II/lac/affine_constraints.h>
+#include <deal.II/lac/dynamic_sparsity_pattern.h>
+#include <deal.II/lac/full_matrix.h>
+#include <deal.II/lac/sparsity_tools.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+#include <deal.II/lac/trilinos_vector.h>
+
+#include <deal.II/numerics/vector_tools.h>
+
+#include "basis_funs.h"
+#include "ela_basis.h"
+#include "forces_and_lame_parameters.h"
+#include "linear_solver.h"
+#include "mytools.h"
+#include "process_parameter_file.h"
+
+// STL
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/**
+ * @file ela_basis_distributed.h
+ *
+ * @brief Fine-scale basis problem of one coarse cell on a group of processors
+ */
+
+namespace Elasticity
+{
+  using namespace dealii;
+
+  /**
+   * @brief Fine-scale basis class for MsFEMs whose fine mesh is distributed
+   *        over a group of processors.
+   *
+   * @tparam dim Space dimension
+   *
+   * This class solves the same problems as ElaBasis, but on a
+   * parallel::distributed::Triangulation over a sub-communicator and with
+   * the LinearSolver of ParametersBasis::linear_solver. It is used by ElaMs
+   * if the fine mesh of a cell has more degrees of freedom than
+   * ParametersBasis::distributed_threshold.
+   *
+   * The results are returned in the layout of ElaBasis::pack_result(), so
+   * the owner of the coarse cell can use them with ElaBasis::unpack_result().
+   * Like ElaBasis::get_basis_values_on_lattice(), this requires the coarse
+   * cell to be a box.
+   */
+  template <int dim>
+  class ElaBasisDistributed
+  {
+  public:
+    /**
+     * @brief Construct a new ElaBasisDistributed object.
+     *
+     * @param corner_points The vertices of the coarse cell
+     * @param global_cell_id The id of the coarse cell
+     * @param mpi_communicator The communicator of the group of processors
+     * @param parameters_basis Parameters of the fine scale
+     * @param global_parameters Shared handle to the parameters that many
+     *                          classes need.
+     * @param lame_scaling Scaling of the Lamé parameters for which the
+     *                     basis functions are constructed.
+     */
+    ElaBasisDistributed(
+      const std::vector<Point<dim>> &                     corner_points,
+      const CellId &                                      global_cell_id,
+      const MPI_Comm                                      mpi_communicator,
+      const ParametersBasis &                             parameters_basis,
+      const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+      const LameScaling &                                 lame_scaling);
+
+    /**
+     * @brief Constructs the basis functions.
+     *
+     * This function is collective on the communicator.
+     */
+    void
+    run();
+
+    /**
+     * @brief Packs the results of run().
+     *
+     * @return std::vector<double> The results in the layout of
+     *         ElaBasis::pack_result() on the first processor of the group,
+     *         an empty vector on the others
+     *
+     * This function is collective on the communicator.
+     */
+    std::vector<double>
+    pack_result() const;
+
+  private:
+    /**
+     * @brief Sets up the mesh, the constraints of all basis functions and
+     *        the matrices.
+     */
+    void
+    setup_system();
+
+    /**
+     * @brief Assembles the matrices and the right-hand side.
+     *
+     * The #system_matrix contains the constraints, the matrices for the
+     * Galerkin projection in assemble_global_element_matrix() do not.
+     */
+    void
+    assemble_system();
+
+    /**
+     * @brief Solves the problem of one basis function.
+     *
+     * @param q_point Index of the basis function
+     */
+    void
+    solve(const unsigned int q_point);
+
+    /**
+     * @brief Projects the fine matrices and the right-hand side onto the
+     *        basis functions.
+     */
+    void
+    assemble_global_element_matrix();
+
+    MPI_Comm                                           mpi_communicator;
+    parallel::distributed::Triangulation<dim>          triangulation;
+    FESystem<dim>                                      fe;
+    DoFHandler<dim>                                    dof_handler;
+    IndexSet                                           locally_owned_dofs;
+    IndexSet                                           locally_relevant_dofs;
+    std::vector<AffineConstraints<double>>             constraints_vector;
+    std::vector<Point<dim>>                            corner_points;
+    TrilinosWrappers::SparseMatrix                     system_matrix;
+    TrilinosWrappers::SparseMatrix                     assembled_cell_matrix;
+    TrilinosWrappers::SparseMatrix                     assembled_matrix_lambda;
+    TrilinosWrappers::SparseMatrix                     assembled_matrix_mu;
+    TrilinosWrappers::MPI::Vector                      assembled_cell_rhs;
+    std::vector<TrilinosWrappers::MPI::Vector>         solution_vector;
+    Vector<double>                                     global_element_rhs;
+    FullMatrix<double>                                 global_element_matrix;
+    FullMatrix<double>                                 element_matrix_lambda;
+    FullMatrix<double>                                 element_matrix_mu;
+    LinearSolver<dim>                                  linear_solver;
+    const CellId                                       global_cell_id;
+    const ParametersBasis                              parameters_basis;
+    const std::shared_ptr<const GlobalParameters<dim>> global_parameters;
+    BasisFun::BasisQ1<dim>                             basis_q1;
+    const LameScaling                                  lame_scaling;
+    ConditionalOStream                                 pcout;
+  };
+
+  // exernal template instantiations
+  extern template class ElaBasisDistributed<2>;
+  extern template class ElaBasisDistributed<3>;
+} // namespace Elasticity
+
+#endif // _INCLUDE_ELA_BASIS_DISTRIBUTED_H_
@@ -0,0 +1,369 @@
+#ifndef _INCLUDE_ELA_BASIS_DISTRIBUTED_TPP_
+#define _INCLUDE_ELA_BASIS_DISTRIBUTED_TPP_
+
+#include "ela_basis_distributed.h"
+
+namespace Elasticity
+{
+  using namespace dealii;
+
+  /****************************************************************************/
+  /* Fine-scale basis problem of one coarse cell on a group of processors */
+
+  template <int dim>
+  ElaBasisDistributed<dim>::ElaBasisDistributed(
+    const std::vector<Point<dim>>                      &corner_points,
+    const CellId                                       &global_cell_id,
+    const MPI_Comm                                      mpi_communicator,
+    const ParametersBasis                              &parameters_basis,
+    const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+    const LameScaling                                  &lame_scaling)
+    : mpi_communicator(mpi_communicator)
+    , triangulation(mpi_communicator)
+    , fe(FE_Q<dim>(1), dim)
+    , dof_handler(triangulation)
+    , constraints_vector(fe.dofs_per_cell)
+    , corner_points(corner_points)
+    , solution_vector(fe.dofs_per_cell)
+    , global_element_rhs(fe.dofs_per_cell)
+    , global_element_matrix(fe.dofs_per_cell, fe.dofs_per_cell)
+    , linear_solver(parameters_basis.linear_solver)
+    , global_cell_id(global_cell_id)
+    , parameters_basis(parameters_basis)
+    , global_parameters(global_parameters)
+    , basis_q1(corner_points)
+    , lame_scaling(lame_scaling)
+    , pcout(std::cout,
+            (Utilities::MPI::this_mpi_process(mpi_communicator) == 0))
+  {}
+
+
+  template <int dim>
+  void
+  ElaBasisDistributed<dim>::setup_system()
+  {
+    GridGenerator::general_cell(triangulation,
+                                corner_points,
+                                /* colorize faces */ false);
+    triangulation.refine_global(parameters_basis.n_refine);
+
+    dof_handler.distribute_dofs(fe);
+    locally_owned_dofs = dof_handler.locally_owned_dofs();
+    DoFTools::extract_locally_relevant_dofs(dof_handler, locally_relevant_dofs);
+
+    for (unsigned int q_index = 0; q_index < fe.dofs_per_cell; ++q_index)
+      {
+        basis_q1.set_index(q_index);
+
+        constraints_vector[q_index].clear();
+        constraints_vector[q_index].reinit(locally_relevant_dofs);
+        DoFTools::make_hanging_node_constraints(dof_handler,
+                                                constraints_vector[q_index]);
+        VectorTools::interpolate_boundary_values(dof_handler,
+                                                 /*boundary id*/ 0,
+                                                 basis_q1,
+                                                 constraints_vector[q_index]);
+        constraints_vector[q_index].close();
+
+        solution_vector[q_index].reinit(locally_owned_dofs, mpi_communicator);
+      }
+
+    // The sparsity pattern is the same for each basis function.
+    DynamicSparsityPattern dsp(locally_relevant_dofs);
+    DoFTools::make_sparsity_pattern(dof_handler,
+                                    dsp,
+                                    constraints_vector[0],
+                                    /*keep_constrained_dofs =*/true);
+    SparsityTools::distribute_sparsity_pattern(
+      dsp,
+      Utilities::MPI::all_gather(mpi_communicator,
+                                 dof_handler.n_locally_owned_dofs()),
+      mpi_communicator,
+      locally_relevant_dofs);
+    system_matrix.reinit(locally_owned_dofs,
+                         locally_owned_dofs,
+                         dsp,
+                         mpi_communicator);
+    assembled_cell_matrix.reinit(system_matrix);
+    if (global_parameters->affine_decomposition)
+      {
+        assembled_matrix_lambda.reinit(system_matrix);
+        assembled_matrix_mu.reinit(system_matrix);
+      }
+
+    assembled_cell_rhs.reinit(locally_owned_dofs, mpi_communicator);
+  }
+
+
+  template <int dim>
+  void
+  ElaBasisDistributed<dim>::assemble_system()
+  {
+    const unsigned int dofs_per_cell = fe.n_dofs_per_cell();
+
+    ElaLocalAssembler<dim> local_assembler(fe,
+                                           global_parameters,
+                                           lame_scaling);
+
+    std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+        {
+          local_assembler.assemble(cell);
+
+          cell->get_dof_indices(local_dof_indices);
+          assembled_cell_matrix.add(local_dof_indices,
+                                    local_assembler.cell_matrix);
+          if (global_parameters->affine_decomposition)
+            {
+              assembled_matrix_lambda.add(local_dof_indices,
+                                          local_assembler.matrix_lambda);
+              assembled_matrix_mu.add(local_dof_indices,
+                                      local_assembler.matrix_mu);
+            }
+          assembled_cell_rhs.add(local_dof_indices, local_assembler.cell_rhs);
+
+          // Only the values of the constraints differ between the basis
+          // functions, so they share the constrained matrix.
+          constraints_vector[0].distribute_local_to_global(
+            local_assembler.cell_matrix, local_dof_indices, system_matrix);
+        }
+
+    system_matrix.compress(VectorOperation::add);
+    assembled_cell_matrix.compress(VectorOperation::add);
+    if (global_parameters->affine_decomposition)
+      {
+        assembled_matrix_lambda.compress(VectorOperation::add);
+        assembled_matrix_mu.compress(VectorOperation::add);
+      }
+    assembled_cell_rhs.compress(VectorOperation::add);
+  }
+
+
+  template <int dim>
+  void
+  ElaBasisDistributed<dim>::solve(const unsigned int q_point)
+  {
+    const AffineConstraints<double> &constraints = constraints_vector[q_point];
+
+    // As in ElaBasis, the basis functions solve the homogeneous problem.
+    // The boundary values g are lifted to the right-hand side, the system
+    // matrix then yields the correction with zero boundary values.
+    TrilinosWrappers::MPI::Vector boundary_values(locally_owned_dofs,
+                                                  mpi_communicator);
+    for (const types::global_dof_index dof : locally_owned_dofs)
+      if (constraints.is_inhomogeneously_constrained(dof))
+        boundary_values(dof) = constraints.get_inhomogeneity(dof);
+    boundary_values.compress(VectorOperation::insert);
+
+    TrilinosWrappers::MPI::Vector system_rhs(locally_owned_dofs,
+                                             mpi_communicator);
+    assembled_cell_matrix.vmult(system_rhs, boundary_values);
+    system_rhs *= -1.;
+    constraints.set_zero(system_rhs);
+
+    // The tolerances of the fine scale apply as in ElaBasis::solve().
+    linear_solver.solve(solution_vector[q_point],
+                        system_rhs,
+                        parameters_basis.solver_tolerance,
+                        parameters_basis.solver_reduction);
+
+    constraints.distribute(solution_vector[q_point]);
+  }
+
+
+  template <int dim>
+  void
+  ElaBasisDistributed<dim>::assemble_global_element_matrix()
+  {
+    const bool affine_decomposition = global_parameters->affine_decomposition;
+    if (affine_decomposition)
+      {
+        element_matrix_lambda.reinit(fe.dofs_per_cell, fe.dofs_per_cell);
+        element_matrix_mu.reinit(fe.dofs_per_cell, fe.dofs_per_cell);
+      }
+
+    TrilinosWrappers::MPI::Vector tmp(locally_owned_dofs, mpi_communicator);
+    for (unsigned int i_trial = 0; i_trial < fe.dofs_per_cell; ++i_trial)
+      {
+        const TrilinosWrappers::MPI::Vector &trial_vec =
+          solution_vector[i_trial];
+
+        assembled_cell_matrix.vmult(tmp, trial_vec);
+        for (unsigned int i_test = 0; i_test < fe.dofs_per_cell; ++i_test)
+          global_element_matrix(i_test, i_trial) =
+            solution_vector[i_test] * tmp;
+
+        if (affine_decomposition)
+          {
+            assembled_matrix_lambda.vmult(tmp, trial_vec);
+            for (unsigned int i_test = 0; i_test < fe.dofs_per_cell; ++i_test)
+              element_matrix_lambda(i_test, i_trial) =
+                solution_vector[i_test] * tmp;
+
+            assembled_matrix_mu.vmult(tmp, trial_vec);
+            for (unsigned int i_test = 0; i_test < fe.dofs_per_cell; ++i_test)
+              element_matrix_mu(i_test, i_trial) =
+                solution_vector[i_test] * tmp;
+          }
+
+        global_element_rhs(i_trial) = trial_vec * assembled_cell_rhs;
+      }
+  }
+
+
+  template <int dim>
+  void
+  ElaBasisDistributed<dim>::run()
+  {
+    Timer timer;
+
+    if (parameters_basis.verbose)
+      {
+        pcout << "	Solving for basis in cell   "
+              << global_cell_id.to_string() << "   [group of "
+              << Utilities::MPI::n_mpi_processes(mpi_communicator)
+              << " ranks]   ..... ";
+      }
+
+    setup_system();
+
+    assemble_system();
+
+    linear_solver.initialize(system_matrix, dof_handler);
+    for (unsigned int q_index = 0; q_index < fe.dofs_per_cell; ++q_index)
+      solve(q_index);
+
+    assemble_global_element_matrix();
+
+    // Free memory as much as possible
+    system_matrix.clear();
+
+    timer.stop();
+    if (parameters_basis.verbose)
+      {
+        pcout << "done in   " << timer.wall_time() << "   seconds."
+              << std::endl;
+      }
+  }
+
+
+  template <int dim>
+  std::vector<double>
+  ElaBasisDistributed<dim>::pack_result() const
+  {
+    std::vector<const FullMatrix<double> *> matrices = {&global_element_matrix};
+    if (global_parameters->affine_decomposition)
+      {
+        matrices.push_back(&element_matrix_lambda);
+        matrices.push_back(&element_matrix_mu);
+      }
+    std::vector<double> result =
+      pack_element_system(global_element_rhs, matrices);
+
+    // Each processor sends the values of its locally owned dofs together
+    // with their lattice entries to the first processor of the group. Only
+    // this processor holds the whole lattice.
+    const unsigned int dofs_per_cell = fe.dofs_per_cell;
+    const unsigned int n_intervals =
+      Utilities::pow(2, parameters_basis.n_refine);
+    const unsigned int n_lattice_points =
+      Utilities::pow(n_intervals + 1, dim);
+
+    const Point<dim> &p1 = corner_points[0];
+    const Point<dim> &p2 =
+      corner_points[GeometryInfo<dim>::vertices_per_cell - 1];
+
+    std::vector<double> local_values;
+    local_values.reserve(locally_owned_dofs.n_elements() *
+                         (1 + dofs_per_cell));
+    std::vector<bool> dof_is_sent(locally_owned_dofs.n_elements(), false);
+
+    std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+        {
+          cell->get_dof_indices(local_dof_indices);
+
+          for (unsigned int k = 0; k < dofs_per_cell; ++k)
+            {
+              const types::global_dof_index dof = local_dof_indices[k];
+              if (!locally_owned_dofs.is_element(dof))
+                continue;
+
+              // Each dof is sent once, although it belongs to several cells.
+              const unsigned int owned_index =
+                locally_owned_dofs.index_within_set(dof);
+              if (dof_is_sent[owned_index])
+                continue;
+              dof_is_sent[owned_index] = true;
+
+              const std::pair<unsigned int, unsigned int> component_and_vertex =
+                fe.system_to_component_index(k);
+              const Point<dim> vertex =
+                cell->vertex(component_and_vertex.second);
+              const unsigned int entry =
+                component_and_vertex.first +
+                dim * MyTools::get_lattice_index(vertex, p1, p2, n_intervals);
+
+              local_values.push_back(entry);
+              for (unsigned int i = 0; i < dofs_per_cell; ++i)
+                local_values.push_back(solution_vector[i][dof]);
+            }
+        }
+
+    const unsigned int n_processes =
+      Utilities::MPI::n_mpi_processes(mpi_communicator);
+    const bool is_root =
+      (Utilities::MPI::this_mpi_process(mpi_communicator) == 0);
+
+    const int        n_local_values = local_values.size();
+    std::vector<int> n_values(n_processes), offsets(n_processes, 0);
+
+    int ierr = MPI_Gather(&n_local_values,
+                          1,
+                          MPI_INT,
+                          n_values.data(),
+                          1,
+                          MPI_INT,
+                          0,
+                          mpi_communicator);
+    AssertThrowMPI(ierr);
+
+    std::vector<double> gathered_values;
+    if (is_root)
+      {
+        for (unsigned int p = 1; p < n_processes; ++p)
+          offsets[p] = offsets[p - 1] + n_values[p - 1];
+        gathered_values.resize(offsets.back() + n_values.back());
+      }
+
+    ierr = MPI_Gatherv(local_values.data(),
+                       n_local_values,
+                       MPI_DOUBLE,
+                       gathered_values.data(),
+                       n_values.data(),
+                       offsets.data(),
+                       MPI_DOUBLE,
+                       0,
+                       mpi_communicator);
+    AssertThrowMPI(ierr);
+
+    if (!is_root)
+      return std::vector<double>();
+
+    const std::size_t first_basis_value = result.size();
+    result.resize(first_basis_value + dim * n_lattice_points * dofs_per_cell,
+                  0.);
+    for (auto value = gathered_values.begin(); value != gathered_values.end();
+         value += 1 + dofs_per_cell)
+      std::copy(value + 1,
+                value + 1 + dofs_per_cell,
+                result.begin() + first_basis_value +
+                  static_cast<unsigned int>(*value) * dofs_per_cell);
+
+    return result;
+  }
+} // namespace Elasticity
+
+#endif // _INCLUDE_ELA_BASIS_DISTRIBUTED_TPP_
@@ -45,7 +45,9 @@
 #include <deal.II/physics/transformations.h>
 
 #include "ela_basis.h"
+#include "ela_basis_distributed.h"
 #include "forces_and_lame_parameters.h"
+#include "linear_solver.h"
 #include "mytools.h"
 #include "postprocessing.h"
 #include "process_parameter_file.h"
@@ -55,9 +57,14 @@
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <list>
 #include <map>
 #include <memory>
+#include <numeric>
+#include <vector>
 
 
 namespace Elasticity
@@ -83,22 +90,84 @@ namespace Elasticity
     /**
      * @brief Construct a new ElaMs object.
      *
-     * @param global_parameters Parameters that many classes need.
+     * @param global_parameters Shared handle to the parameters that many
+     *                          classes need.
      * @param parameters_ms Parameters that only this class needs.
      * @param parameters_basis Parameters for the fine-scale part of the MsFEM.
+     * @param mpi_communicator The MPI communicator
      */
-    ElaMs(const GlobalParameters<dim> &global_parameters,
-          const ParametersMs &         parameters_ms,
-          const ParametersBasis &      parameters_basis);
+    ElaMs(const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+          const ParametersMs &                                parameters_ms,
+          const ParametersBasis &                             parameters_basis,
+          const MPI_Comm mpi_communicator = MPI_COMM_WORLD);
 
     /**
      * @brief Function that runs the problem.
      *
+     * @param write_output If false, no vtu files are written.
+     *
      * This function runs all the member functions
      * that are necessary to solve the problem.
+     *
+     * The coarse mesh uses ParametersMs::n_refine global refinements and
+     * the fine-scale problems ParametersBasis::n_refine. Every further
+     * cycle refines the fine-scale problems once more.
+     */
+    void
+    run(const bool write_output = true);
+
+    /**
+     * @brief Evaluates the fine-scale MsFEM solution at the quadrature
+     *        points of the fine cells of all locally owned coarse cells.
+     *
+     * @param points Quadrature points
+     * @param JxW Quadrature weights times the Jacobian determinant
+     * @param values Displacement at the quadrature points
+     * @param gradients Gradient of the displacement at the quadrature
+     *                  points
+     *
+     * The fine-scale solution is reconstructed from the basis functions
+     * with the weights of the last solution computed by run().
+     */
+    void
+    get_fine_solution_at_quadrature_points(
+      std::vector<Point<dim>> &    points,
+      std::vector<double> &        JxW,
+      std::vector<Tensor<1, dim>> &values,
+      std::vector<Tensor<2, dim>> &gradients) const;
+
+    /**
+     * @brief Returns the DoFHandler of the coarse mesh.
+     *
+     * @return const DoFHandler<dim>&
+     */
+    const DoFHandler<dim> &
+    get_dof_handler() const;
+
+    /**
+     * @brief Returns the number of refinements of the coarse cells for the
+     *        basis functions in the last cycle.
+     *
+     * @return unsigned int
+     */
+    unsigned int
+    get_n_basis_refinements() const;
+
+    /**
+     * @brief Returns the basis functions of a locally owned coarse cell at
+     *        the vertices of its fine mesh.
+     *
+     * @param cell_id Id of the coarse cell
+     * @param dof_indices Global indices of the coarse degrees of freedom
+     *                    of the cell
+     * @param values Values of the basis functions, see
+     *               ElaBasis::get_basis_values_on_lattice()
      */
     void
-    run();
+    get_basis_values_on_lattice(
+      const CellId &                        cell_id,
+      std::vector<types::global_dof_index> &dof_indices,
+      std::vector<double> &                 values) const;
 
   private:
     /**
@@ -114,37 +183,199 @@ namespace Elasticity
     void
     setup_system();
 
+    /**
+     * @brief Sets up the constraints of a load case.
+     *
+     * @param load_case The load case
+     *
+     * All load cases constrain the same degrees of freedom, only the
+     * values of the rotation differ.
+     */
+    void
+    setup_constraints(const LoadCase &load_case);
+
     /**
      * @brief Initializes and computes the basis functions.
      *
      * This function initializes and computes the local basis functions
      * on each cell with the MsFEM by creating an ElaBasis object for
      * each cell and computing the basis functions with these objects.
+     *
+     * The basis functions are constructed for #basis_lame_scaling.
      */
     void
     initialize_and_compute_basis(unsigned int cycle);
 
+    /**
+     * @brief Describes the basis problem of a locally owned cell for
+     *        another processor.
+     *
+     * @param cell_id Id of the cell
+     * @return std::vector<double> The entries of the binary CellId
+     *         followed by the corner points of the cell
+     */
+    std::vector<double>
+    get_task_description(const CellId &cell_id) const;
+
+    /**
+     * @brief Reads the output of get_task_description().
+     *
+     * @param description The description of the task
+     * @param corner_points The vertices of the cell
+     * @return CellId Id of the cell
+     */
+    CellId
+    read_task_description(const std::vector<double> &description,
+                          std::vector<Point<dim>> &  corner_points) const;
+
+    /**
+     * @brief Computes the basis functions of a cell of another processor.
+     *
+     * @param description Output of get_task_description()
+     * @param cycle The refinement cycle
+     * @param progress_callback Passed on to ElaBasis::run()
+     * @return std::vector<double> The wall time of the computation followed
+     *         by the output of ElaBasis::pack_result()
+     */
+    std::vector<double>
+    compute_remote_basis(const std::vector<double>   &description,
+                         const unsigned int           cycle,
+                         const std::function<void()> &progress_callback =
+                           std::function<void()>()) const;
+
+    /**
+     * @brief Computes the basis functions of #cell_basis_map with work
+     *        stealing between the processors.
+     *
+     * @param cycle The refinement cycle
+     *
+     * Each processor first computes its own cells. Then it asks the other
+     * processors one after another for cells with point-to-point messages
+     * until they have none left, and sends the results back to the owner.
+     * Finally, each processor receives the results of its stolen cells.
+     *
+     * Most MPI implementations only progress messages inside MPI calls, so
+     * one-sided access would wait until the busy victim is done with its
+     * cell. Instead, the victim itself answers the requests, between two
+     * basis functions via the callback of ElaBasis::run() and whenever it
+     * waits. A request is thus delayed by at most one basis problem.
+     */
+    void
+    compute_basis_with_work_stealing(const unsigned int cycle);
+
+    /**
+     * @brief Computes the basis functions of #cell_basis_map on all
+     *        processors of the communicator.
+     *
+     * @param cycle The refinement cycle
+     *
+     * The cells are assigned to the processors in contiguous blocks of equal
+     * size, independently of the partition of the coarse mesh. Thus,
+     * processors without coarse cells also compute basis functions. The
+     * descriptions and the results are exchanged with
+     * Utilities::MPI::some_to_some().
+     */
+    void
+    compute_basis_on_all_processors(const unsigned int cycle);
+
+    /**
+     * @brief Computes the basis functions of #cell_basis_map with
+     *        ElaBasisDistributed.
+     *
+     * The communicator is split into groups of
+     * ParametersBasis::processes_per_cell consecutive ranks. The cells of
+     * all processors are split into contiguous blocks for the groups and
+     * each group solves the problems of its cells one after another on a
+     * distributed fine mesh. The results are sent to the owners of the
+     * cells.
+     */
+    void
+    compute_basis_distributed();
+
+    /**
+     * @brief Returns the weight of a coarse cell for the partitioning.
+     *
+     * @param cell The cell
+     * @param status What happens to the cell in the refinement
+     * @return unsigned int Weight that p4est adds to its default weight 1000
+     *
+     * Cells whose basis functions were computed on this processor are
+     * weighted with the measured cost in #basis_cost relative to the mean
+     * cost. Otherwise, the weight is estimated with
+     * estimate_basis_cost() if ParametersMs::a_priori_weights is set.
+     */
+    unsigned int
+    get_cell_weight(
+      const typename Triangulation<dim>::cell_iterator &cell,
+      const typename Triangulation<dim>::CellStatus     status) const;
+
+    /**
+     * @brief Estimates the relative cost of the basis functions of a cell
+     *        before they are computed.
+     *
+     * @param cell The cell
+     * @return double Square root of the larger of the contrasts of the
+     *                two Lamé parameters in the cell, 1 for a homogeneous
+     *                cell
+     *
+     * The number of CG iterations grows with the square root of the
+     * condition number, which grows with the contrast of the material.
+     */
+    double
+    estimate_basis_cost(
+      const typename Triangulation<dim>::cell_iterator &cell) const;
+
     /**
      * @brief Assembles the system.
      *
+     * @param load_case The load case for which the #system_rhs is assembled
+     * @param assemble_matrix True if the #system_matrix shall be assembled
+     *
      * This function assembles the #system_matrix and the #system_rhs by
      * assembling the contributions of all the ElaBasis objects and adding
      * the Neumann boundary condition.
+     *
+     * With GlobalParameters::affine_decomposition, the matrices
+     * #system_matrix_lambda and #system_matrix_mu are assembled instead
+     * and combined into the #system_matrix.
+     */
+    void
+    assemble_system(const LoadCase &load_case, const bool assemble_matrix);
+
+    /**
+     * @brief Combines #system_matrix_lambda and #system_matrix_mu
+     *        into the #system_matrix with the scalings of #lame_scaling.
+     */
+    void
+    combine_system_matrix();
+
+    /**
+     * @brief Factorizes the #system_matrix or sets up the preconditioner.
+     *
+     * @param reuse_structure If true, only the entries of the
+     *                        #system_matrix have changed since the last
+     *                        call, see LinearSolver::initialize().
+     *
+     * The solver is chosen in #parameters_ms, see LinearSolver. The result is
+     * reused by solve() for all load cases.
      */
     void
-    assemble_system();
+    initialize_solver(const bool reuse_structure = false);
 
     /**
      * @brief Solves the global problem.
      *
-     * This function solves the global problem.
+     * @param completely_distributed_solution Vector for the solution
+     *
+     * This function solves the global problem with the #system_rhs and the
+     * solver set up in initialize_solver().
      *
-     * In #parameters_ms, it can be specified if a direct
-     * or iterative (CG-method with AMG preconditioner) shall
-     * be used.
+     * If the vector is already a vector of the locally owned dofs, it is
+     * the initial guess of the iterative solver (see
+     * ParametersSolver::warm_start), otherwise it is initialized with zero.
      */
     void
-    solve();
+    solve(TrilinosWrappers::MPI::Vector &completely_distributed_solution);
 
     /**
      * @brief Sends global weights to cell.
@@ -176,27 +407,44 @@ namespace Elasticity
      * In the latter case, it lets each ElaBasis object output the
      * local solution as vtu files and combines all of them into a
      * single pvtu file.
+     *
+     * @param cycle The refinement cycle
+     * @param material Index of the material in
+     *                 GlobalParameters::material_sweep
+     * @param load_case Index of the load case in GlobalParameters::load_cases
      */
     void
-    output_results(unsigned int cycle);
-
-    MPI_Comm                                  mpi_communicator;
-    parallel::distributed::Triangulation<dim> triangulation;
-    FESystem<dim>                             fe;
-    DoFHandler<dim>                           dof_handler;
-    IndexSet                                  locally_owned_dofs;
-    IndexSet                                  locally_relevant_dofs;
-    AffineConstraints<double>                 constraints;
-    TrilinosWrappers::SparseMatrix            system_matrix;
-    TrilinosWrappers::SparseMatrix            preconditioner_matrix;
-    TrilinosWrappers::MPI::Vector             locally_relevant_solution;
-    TrilinosWrappers::MPI::Vector             system_rhs;
-    std::map<CellId, ElaBasis<dim>>           cell_basis_map;
-    const GlobalParameters<dim>               global_parameters;
-    const ParametersMs                        parameters_ms;
-    ParametersBasis                           parameters_basis;
-    bool                                      processor_is_used;
+    output_results(const unsigned int cycle,
+                   const unsigned int material,
+                   const unsigned int load_case);
+
+    MPI_Comm                                           mpi_communicator;
+    parallel::distributed::Triangulation<dim>          triangulation;
+    FESystem<dim>                                      fe;
+    DoFHandler<dim>                                    dof_handler;
+    IndexSet                                           locally_owned_dofs;
+    IndexSet                                           locally_relevant_dofs;
+    AffineConstraints<double>                          constraints;
+    TrilinosWrappers::SparseMatrix                     system_matrix;
+    TrilinosWrappers::SparseMatrix                     system_matrix_lambda;
+    TrilinosWrappers::SparseMatrix                     system_matrix_mu;
+    TrilinosWrappers::SparseMatrix                     preconditioner_matrix;
+    TrilinosWrappers::MPI::Vector                      locally_relevant_solution;
+    TrilinosWrappers::MPI::Vector                      system_rhs;
+    LinearSolver<dim>                                  linear_solver;
+    std::map<CellId, ElaBasis<dim>>                    cell_basis_map;
+    const std::shared_ptr<const GlobalParameters<dim>> global_parameters;
+    const ParametersMs                                 parameters_ms;
+    ParametersBasis                                    parameters_basis;
+    LameScaling                                        lame_scaling;
+    LameScaling                                        basis_lame_scaling;
+    /**< Scaling of the Lamé parameters of the current basis functions. */
+    bool                                               processor_is_used;
     /**< True if this processor is assigned at least one coarse cell. */
+    std::map<CellId, double>                           basis_cost;
+    /**< Wall time of ElaBasis::run() for the locally owned cells. */
+    double                                             mean_basis_cost;
+    /**< Mean of #basis_cost over all processors. */
 
     ConditionalOStream pcout;
     TimerOutput        computing_timer;
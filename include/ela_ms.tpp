@@ -13,28 +13,41 @@ namespace Elasticity
 
   // The constructor
   template <int dim>
-  ElaMs<dim>::ElaMs(const GlobalParameters<dim> &global_parameters,
-                    const ParametersMs          &parameters_ms,
-                    const ParametersBasis       &parameters_basis)
-    : mpi_communicator(MPI_COMM_WORLD)
+  ElaMs<dim>::ElaMs(
+    const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+    const ParametersMs                                 &parameters_ms,
+    const ParametersBasis                              &parameters_basis,
+    const MPI_Comm                                      mpi_communicator)
+    : mpi_communicator(mpi_communicator)
     , triangulation(mpi_communicator,
                     typename Triangulation<dim>::MeshSmoothing(
                       Triangulation<dim>::smoothing_on_refinement |
                       Triangulation<dim>::smoothing_on_coarsening))
     , fe(FE_Q<dim>(1), dim)
     , dof_handler(triangulation)
+    , linear_solver(parameters_ms.linear_solver)
     , cell_basis_map()
     , global_parameters(global_parameters)
     , parameters_ms(parameters_ms)
     , parameters_basis(parameters_basis)
+    , lame_scaling(global_parameters->material_sweep[0])
+    , basis_lame_scaling(lame_scaling)
     , processor_is_used(false)
+    , mean_basis_cost(0)
     , pcout(std::cout,
             (Utilities::MPI::this_mpi_process(mpi_communicator) == 0))
     , computing_timer(mpi_communicator,
                       pcout,
                       TimerOutput::summary,
                       TimerOutput::wall_times)
-  {}
+  {
+    if (parameters_ms.weighted_partitioning)
+      triangulation.signals.cell_weight.connect(
+        [this](const typename Triangulation<dim>::cell_iterator &cell,
+               const typename Triangulation<dim>::CellStatus     status) {
+          return get_cell_weight(cell, status);
+        });
+  }
 
 
   template <int dim>
@@ -49,44 +62,20 @@ namespace Elasticity
                                      locally_relevant_dofs,
                                      mpi_communicator);
     system_rhs.reinit(locally_owned_dofs, mpi_communicator);
-    constraints.clear();
-    constraints.reinit(locally_relevant_dofs);
-    DoFTools::make_hanging_node_constraints(dof_handler, constraints);
-    unsigned int dirichlet_id = 0;
 
     // The next part is used if a Dirichlet boundary condition is only applied
     // on a part of a face.
 
-    if (global_parameters.other_dirichlet_id)
+    if (global_parameters->other_dirichlet_id)
       {
-        const Point<dim> p1(global_parameters.dirichlet_p1),
-          p2(global_parameters.dirichlet_p2);
+        const Point<dim> p1(global_parameters->dirichlet_p1),
+          p2(global_parameters->dirichlet_p2);
         MyTools::set_dirichlet_id<dim>(p1, p2, 4, 100, triangulation);
-        dirichlet_id = 100;
-      }
-
-    VectorTools::interpolate_boundary_values(dof_handler,
-                                             dirichlet_id,
-                                             Functions::ZeroFunction<dim>(dim),
-                                             constraints);
-
-
-    if (dim == 3)
-      {
-        if (global_parameters.rotate)
-          {
-            VectorTools::interpolate_boundary_values(
-              dof_handler,
-              1,
-              MyTools::Rotation<dim>(global_parameters.init_p1,
-                                     global_parameters.init_p2,
-                                     global_parameters.angle),
-              constraints);
-          }
       }
 
+    // The constrained degrees of freedom are the same for all load cases.
+    setup_constraints(global_parameters->load_cases[0]);
 
-    constraints.close();
     DynamicSparsityPattern dsp(locally_relevant_dofs);
     DoFTools::make_sparsity_pattern(dof_handler, dsp, constraints, true);
     SparsityTools::distribute_sparsity_pattern(
@@ -100,16 +89,26 @@ namespace Elasticity
                          dsp,
                          mpi_communicator);
 
+    if (global_parameters->affine_decomposition)
+      {
+        system_matrix_lambda.reinit(system_matrix);
+        system_matrix_mu.reinit(system_matrix);
+      }
+
     // std::filesystem::create_directories("output/basis_output/");
     // std::filesystem::create_directory("output/global_basis_output/");
     // std::filesystem::create_directory("output/coarse/");
 
     try
       {
-        MyTools::create_data_directory("output/");
-        MyTools::create_data_directory("output/basis_output/");
-        MyTools::create_data_directory("output/global_basis_output/");
-        MyTools::create_data_directory("output/coarse/");
+        const std::string &output_directory =
+          global_parameters->output_directory;
+        MyTools::create_data_directory(output_directory.c_str());
+        MyTools::create_data_directory(
+          (output_directory + "basis_output/").c_str());
+        MyTools::create_data_directory(
+          (output_directory + "global_basis_output/").c_str());
+        MyTools::create_data_directory((output_directory + "coarse/").c_str());
       }
     catch (std::runtime_error &e)
       {
@@ -122,6 +121,42 @@ namespace Elasticity
   }
 
 
+  template <int dim>
+  void
+  ElaMs<dim>::setup_constraints(const LoadCase &load_case)
+  {
+    constraints.clear();
+    constraints.reinit(locally_relevant_dofs);
+    DoFTools::make_hanging_node_constraints(dof_handler, constraints);
+
+    const unsigned int dirichlet_id =
+      (global_parameters->other_dirichlet_id ? 100 : 0);
+
+    VectorTools::interpolate_boundary_values(dof_handler,
+                                             dirichlet_id,
+                                             Functions::ZeroFunction<dim>(dim),
+                                             constraints);
+
+
+    if (dim == 3)
+      {
+        if (global_parameters->rotate)
+          {
+            VectorTools::interpolate_boundary_values(
+              dof_handler,
+              1,
+              MyTools::Rotation<dim>(global_parameters->init_p1,
+                                     global_parameters->init_p2,
+                                     load_case.angle),
+              constraints);
+          }
+      }
+
+
+    constraints.close();
+  }
+
+
   template <int dim>
   void
   ElaMs<dim>::initialize_and_compute_basis(unsigned int cycle)
@@ -149,7 +184,8 @@ namespace Elasticity
               mpi_communicator,
               parameters_basis,
               global_parameters,
-              cycle);
+              cycle,
+              basis_lame_scaling);
 
             std::pair<typename std::map<CellId, ElaBasis<dim>>::iterator, bool>
               result;
@@ -174,16 +210,521 @@ namespace Elasticity
                                                          cell_basis_map.begin(),
                                                        it_endbasis =
                                                          cell_basis_map.end();
-    for (; it_basis != it_endbasis; ++it_basis)
+    // Fine meshes with too many dofs for one processor are distributed
+    // over groups of processors.
+    const double n_fine_dofs =
+      dim * std::pow(std::pow(2., parameters_basis.n_refine) + 1., dim);
+    const bool distributed =
+      (parameters_basis.distributed_threshold > 0 &&
+       n_fine_dofs > parameters_basis.distributed_threshold);
+
+    // ElaBasisDistributed always refines uniformly and solves with the
+    // LinearSolver in double precision, so it must not silently ignore the
+    // options of ElaBasis that change this.
+    AssertThrow(!distributed ||
+                  (parameters_basis.n_levels == 1 &&
+                   parameters_basis.refinement == "global" &&
+                   !parameters_basis.single_precision &&
+                   parameters_basis.tolerance_policy == "fixed"),
+                ExcMessage("Basis functions on groups of processors only "
+                           "support one level, global refinement, double "
+                           "precision and the fixed tolerance policy."));
+
+    basis_cost.clear();
+    if (distributed)
+      compute_basis_distributed();
+    else if (parameters_ms.basis_scheduling == "work stealing")
+      compute_basis_with_work_stealing(cycle);
+    else if (parameters_ms.basis_scheduling == "all processors")
+      compute_basis_on_all_processors(cycle);
+    else
+      for (; it_basis != it_endbasis; ++it_basis)
+        {
+          Timer timer;
+          (it_basis->second).run();
+
+          basis_cost[it_basis->first] = timer.wall_time();
+        }
+
+    double local_basis_cost = 0;
+    for (const auto &cell_cost : basis_cost)
+      local_basis_cost += cell_cost.second;
+
+    mean_basis_cost = Utilities::MPI::sum(local_basis_cost, mpi_communicator) /
+                      triangulation.n_global_active_cells();
+  }
+
+
+  template <int dim>
+  std::vector<double>
+  ElaMs<dim>::get_task_description(const CellId &cell_id) const
+  {
+    const CellId::binary_type id = cell_id.template to_binary<dim>();
+    std::vector<double>       description(id.begin(), id.end());
+
+    const auto cell = cell_id.to_cell(triangulation);
+    for (unsigned int v = 0; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+      for (unsigned int d = 0; d < dim; ++d)
+        description.push_back(cell->vertex(v)[d]);
+
+    return description;
+  }
+
+
+  template <int dim>
+  CellId
+  ElaMs<dim>::read_task_description(
+    const std::vector<double> &description,
+    std::vector<Point<dim>>   &corner_points) const
+  {
+    // The entries of a CellId are unsigned integers and thus exactly
+    // representable as double.
+    const unsigned int n_id_values =
+      std::tuple_size<CellId::binary_type>::value;
+    CellId::binary_type binary_id;
+    for (unsigned int i = 0; i < n_id_values; ++i)
+      binary_id[i] = static_cast<unsigned int>(description[i]);
+
+    corner_points.resize(GeometryInfo<dim>::vertices_per_cell);
+    for (unsigned int v = 0; v < corner_points.size(); ++v)
+      for (unsigned int d = 0; d < dim; ++d)
+        corner_points[v][d] = description[n_id_values + v * dim + d];
+
+    return CellId(binary_id);
+  }
+
+
+  template <int dim>
+  std::vector<double>
+  ElaMs<dim>::compute_remote_basis(
+    const std::vector<double>   &description,
+    const unsigned int           cycle,
+    const std::function<void()> &progress_callback) const
+  {
+    std::vector<Point<dim>> corner_points;
+    const CellId cell_id = read_task_description(description, corner_points);
+
+    // The basis functions of cells of other processors are not written to
+    // files.
+    ParametersBasis remote_parameters_basis(parameters_basis);
+    remote_parameters_basis.prevent_output = true;
+
+    Timer         timer;
+    ElaBasis<dim> remote_cell_problem(corner_points,
+                                      cell_id,
+                                      mpi_communicator,
+                                      remote_parameters_basis,
+                                      global_parameters,
+                                      cycle,
+                                      basis_lame_scaling);
+    remote_cell_problem.run(progress_callback);
+
+    std::vector<double> result = remote_cell_problem.pack_result();
+    result.insert(result.begin(), timer.wall_time());
+
+    return result;
+  }
+
+
+  template <int dim>
+  void
+  ElaMs<dim>::compute_basis_with_work_stealing(const unsigned int cycle)
+  {
+    const unsigned int this_process =
+      Utilities::MPI::this_mpi_process(mpi_communicator);
+    const unsigned int n_processes =
+      Utilities::MPI::n_mpi_processes(mpi_communicator);
+    const int request_tag = 4710;
+    const int task_tag    = 4711;
+    const int result_tag  = 4712;
+
+    std::vector<typename std::map<CellId, ElaBasis<dim>>::iterator> tasks;
+    for (auto it = cell_basis_map.begin(); it != cell_basis_map.end(); ++it)
+      tasks.push_back(it);
+
+    // Tasks of this processor with a smaller index are taken, either here
+    // or by a thief.
+    unsigned int next_task = 0, n_stolen_tasks = 0;
+
+    // Answers all pending requests of thieves with the next task and its
+    // description, or with an empty message if no task is left.
+    const auto serve_requests = [&]() {
+      int        pending;
+      MPI_Status status;
+      MPI_Iprobe(
+        MPI_ANY_SOURCE, request_tag, mpi_communicator, &pending, &status);
+      while (pending)
+        {
+          MPI_Recv(nullptr,
+                   0,
+                   MPI_DOUBLE,
+                   status.MPI_SOURCE,
+                   request_tag,
+                   mpi_communicator,
+                   MPI_STATUS_IGNORE);
+
+          std::vector<double> reply;
+          if (next_task < tasks.size())
+            {
+              reply = get_task_description(tasks[next_task]->first);
+              reply.insert(reply.begin(), static_cast<double>(next_task));
+              ++next_task;
+              ++n_stolen_tasks;
+            }
+          MPI_Send(reply.data(),
+                   reply.size(),
+                   MPI_DOUBLE,
+                   status.MPI_SOURCE,
+                   task_tag,
+                   mpi_communicator);
+
+          MPI_Iprobe(
+            MPI_ANY_SOURCE, request_tag, mpi_communicator, &pending, &status);
+        }
+    };
+
+    // Basis functions are long computations without MPI calls, so the
+    // requests are also served between two of them.
+    while (next_task < tasks.size())
+      {
+        const unsigned int task = next_task++;
+
+        Timer timer;
+        tasks[task]->second.run(serve_requests);
+
+        basis_cost[tasks[task]->first] = timer.wall_time();
+        serve_requests();
+      }
+
+    std::list<std::vector<double>> results;
+    std::vector<MPI_Request>       requests;
+    for (unsigned int offset = 1; offset < n_processes; ++offset)
+      {
+        const unsigned int victim = (this_process + offset) % n_processes;
+        while (true)
+          {
+            MPI_Send(
+              nullptr, 0, MPI_DOUBLE, victim, request_tag, mpi_communicator);
+
+            // The victim may wait for an answer of this processor itself.
+            int        arrived = 0;
+            MPI_Status status;
+            while (!arrived)
+              {
+                serve_requests();
+                MPI_Iprobe(
+                  victim, task_tag, mpi_communicator, &arrived, &status);
+              }
+
+            int size;
+            MPI_Get_count(&status, MPI_DOUBLE, &size);
+            std::vector<double> reply(size);
+            MPI_Recv(reply.data(),
+                     size,
+                     MPI_DOUBLE,
+                     victim,
+                     task_tag,
+                     mpi_communicator,
+                     MPI_STATUS_IGNORE);
+            if (reply.empty())
+              break;
+
+            // The first entry is the task, followed by its cost and the
+            // packed basis functions.
+            results.push_back(compute_remote_basis(
+              std::vector<double>(reply.begin() + 1, reply.end()),
+              cycle,
+              serve_requests));
+            results.back().insert(results.back().begin(), reply[0]);
+
+            requests.emplace_back();
+            MPI_Isend(results.back().data(),
+                      results.back().size(),
+                      MPI_DOUBLE,
+                      victim,
+                      result_tag,
+                      mpi_communicator,
+                      &requests.back());
+          }
+      }
+
+    // All tasks of this processor are taken now, the stolen ones are
+    // received from the thieves.
+    for (unsigned int i = 0; i < n_stolen_tasks; ++i)
+      {
+        int        arrived = 0;
+        MPI_Status status;
+        while (!arrived)
+          {
+            serve_requests();
+            MPI_Iprobe(
+              MPI_ANY_SOURCE, result_tag, mpi_communicator, &arrived, &status);
+          }
+
+        int size;
+        MPI_Get_count(&status, MPI_DOUBLE, &size);
+        std::vector<double> result(size);
+        MPI_Recv(result.data(),
+                 size,
+                 MPI_DOUBLE,
+                 status.MPI_SOURCE,
+                 result_tag,
+                 mpi_communicator,
+                 MPI_STATUS_IGNORE);
+
+        const unsigned int task = static_cast<unsigned int>(result[0]);
+        basis_cost[tasks[task]->first] = result[1];
+        tasks[task]->second.unpack_result(
+          std::vector<double>(result.begin() + 2, result.end()));
+      }
+
+    int sent = 0;
+    while (!sent)
+      {
+        serve_requests();
+        MPI_Testall(
+          requests.size(), requests.data(), &sent, MPI_STATUSES_IGNORE);
+      }
+
+    // Other processors may still ask for tasks until all of them are done.
+    MPI_Request barrier;
+    MPI_Ibarrier(mpi_communicator, &barrier);
+    int done = 0;
+    while (!done)
+      {
+        serve_requests();
+        MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+      }
+  }
+
+
+  template <int dim>
+  void
+  ElaMs<dim>::compute_basis_on_all_processors(const unsigned int cycle)
+  {
+    const unsigned int this_process =
+      Utilities::MPI::this_mpi_process(mpi_communicator);
+    const unsigned int n_processes =
+      Utilities::MPI::n_mpi_processes(mpi_communicator);
+
+    std::vector<typename std::map<CellId, ElaBasis<dim>>::iterator> tasks;
+    for (auto it = cell_basis_map.begin(); it != cell_basis_map.end(); ++it)
+      tasks.push_back(it);
+
+    const std::vector<unsigned int> n_tasks =
+      Utilities::MPI::all_gather(mpi_communicator,
+                                 static_cast<unsigned int>(tasks.size()));
+    const unsigned long long first_task =
+      std::accumulate(n_tasks.begin(), n_tasks.begin() + this_process, 0ull);
+    const unsigned long long n_global_tasks =
+      std::accumulate(n_tasks.begin(), n_tasks.end(), 0ull);
+
+    // The tasks of all processors in the order of the ranks are split into
+    // contiguous blocks of (almost) equal size, so most cells stay with
+    // their owner.
+    std::vector<unsigned int> local_tasks;
+    std::map<unsigned int, std::vector<std::vector<double>>> sent_tasks;
+    for (unsigned int task = 0; task < tasks.size(); ++task)
+      {
+        const unsigned int process = static_cast<unsigned int>(
+          (first_task + task) * n_processes / n_global_tasks);
+
+        if (process == this_process)
+          {
+            local_tasks.push_back(task);
+          }
+        else
+          {
+            // The first entry is the task, followed by its description.
+            sent_tasks[process].push_back({static_cast<double>(task)});
+            const std::vector<double> description =
+              get_task_description(tasks[task]->first);
+            sent_tasks[process].back().insert(
+              sent_tasks[process].back().end(),
+              description.begin(),
+              description.end());
+          }
+      }
+
+    const std::map<unsigned int, std::vector<std::vector<double>>>
+      received_tasks = Utilities::MPI::some_to_some(mpi_communicator,
+                                                    sent_tasks);
+
+    for (const unsigned int task : local_tasks)
+      {
+        Timer timer;
+        tasks[task]->second.run();
+
+        basis_cost[tasks[task]->first] = timer.wall_time();
+      }
+
+    // The results are returned to the owners with the same task index,
+    // followed by the cost and the packed basis functions.
+    std::map<unsigned int, std::vector<std::vector<double>>> sent_results;
+    for (const auto &process_and_tasks : received_tasks)
+      for (const std::vector<double> &task : process_and_tasks.second)
+        {
+          sent_results[process_and_tasks.first].push_back(
+            compute_remote_basis(
+              std::vector<double>(task.begin() + 1, task.end()), cycle));
+          sent_results[process_and_tasks.first].back().insert(
+            sent_results[process_and_tasks.first].back().begin(), task[0]);
+        }
+
+    const std::map<unsigned int, std::vector<std::vector<double>>>
+      received_results = Utilities::MPI::some_to_some(mpi_communicator,
+                                                      sent_results);
+
+    for (const auto &process_and_results : received_results)
+      for (const std::vector<double> &result : process_and_results.second)
+        {
+          const unsigned int task = static_cast<unsigned int>(result[0]);
+          basis_cost[tasks[task]->first] = result[1];
+          tasks[task]->second.unpack_result(
+            std::vector<double>(result.begin() + 2, result.end()));
+        }
+  }
+
+
+  template <int dim>
+  void
+  ElaMs<dim>::compute_basis_distributed()
+  {
+    const unsigned int this_process =
+      Utilities::MPI::this_mpi_process(mpi_communicator);
+    const unsigned int n_processes =
+      Utilities::MPI::n_mpi_processes(mpi_communicator);
+
+    // Groups of consecutive ranks, the last group takes the remaining ones.
+    const unsigned int group_size =
+      std::min(parameters_basis.processes_per_cell, n_processes);
+    const unsigned int n_groups = n_processes / group_size;
+    const unsigned int group =
+      std::min(this_process / group_size, n_groups - 1);
+
+    MPI_Comm group_communicator;
+    MPI_Comm_split(mpi_communicator, group, this_process, &group_communicator);
+    const bool is_group_root =
+      (Utilities::MPI::this_mpi_process(group_communicator) == 0);
+
+    std::vector<typename std::map<CellId, ElaBasis<dim>>::iterator> tasks;
+    std::vector<std::vector<double>> descriptions;
+    for (auto it = cell_basis_map.begin(); it != cell_basis_map.end(); ++it)
+      {
+        tasks.push_back(it);
+        descriptions.push_back(get_task_description(it->first));
+      }
+
+    // All processors know all tasks, the tasks in the order of the ranks
+    // are split into contiguous blocks for the groups.
+    const std::vector<std::vector<std::vector<double>>> all_descriptions =
+      Utilities::MPI::all_gather(mpi_communicator, descriptions);
+    unsigned long long n_global_tasks = 0;
+    for (const auto &process_descriptions : all_descriptions)
+      n_global_tasks += process_descriptions.size();
+
+    // The results are sent by the root of the group to the owner with the
+    // index of the task, the cost on all processors of the group and the
+    // packed basis functions.
+    std::map<unsigned int, std::vector<std::vector<double>>> sent_results;
+    unsigned long long global_task = 0;
+    for (unsigned int process = 0; process < n_processes; ++process)
+      for (unsigned int task = 0; task < all_descriptions[process].size();
+           ++task, ++global_task)
+        if (global_task * n_groups / n_global_tasks == group)
+          {
+            std::vector<Point<dim>> corner_points;
+            const CellId            cell_id =
+              read_task_description(all_descriptions[process][task],
+                                    corner_points);
+
+            Timer                    timer;
+            ElaBasisDistributed<dim> cell_problem(corner_points,
+                                                  cell_id,
+                                                  group_communicator,
+                                                  parameters_basis,
+                                                  global_parameters,
+                                                  basis_lame_scaling);
+            cell_problem.run();
+            std::vector<double> result = cell_problem.pack_result();
+
+            if (is_group_root)
+              {
+                result.insert(result.begin(),
+                              {static_cast<double>(task),
+                               group_size * timer.wall_time()});
+                sent_results[process].push_back(std::move(result));
+              }
+          }
+
+    const std::map<unsigned int, std::vector<std::vector<double>>>
+      received_results = Utilities::MPI::some_to_some(mpi_communicator,
+                                                      sent_results);
+
+    for (const auto &process_and_results : received_results)
+      for (const std::vector<double> &result : process_and_results.second)
+        {
+          const unsigned int task = static_cast<unsigned int>(result[0]);
+          basis_cost[tasks[task]->first] = result[1];
+          tasks[task]->second.unpack_result(
+            std::vector<double>(result.begin() + 2, result.end()));
+        }
+
+    MPI_Comm_free(&group_communicator);
+  }
+
+
+  template <int dim>
+  unsigned int
+  ElaMs<dim>::get_cell_weight(
+    const typename Triangulation<dim>::cell_iterator &cell,
+    const typename Triangulation<dim>::CellStatus     status) const
+  {
+    // The basis functions dominate the cost of a coarse cell, so their
+    // weight is large compared to the default weight 1000 of p4est.
+    if (status == Triangulation<dim>::CELL_PERSIST && mean_basis_cost > 0)
       {
-        (it_basis->second).run();
+        const auto it = basis_cost.find(cell->id());
+        if (it != basis_cost.end())
+          return static_cast<unsigned int>(
+            std::round(10000. * it->second / mean_basis_cost));
       }
+
+    if (parameters_ms.a_priori_weights)
+      return static_cast<unsigned int>(
+        std::round(1000. * estimate_basis_cost(cell)));
+
+    return 0;
+  }
+
+
+  template <int dim>
+  double
+  ElaMs<dim>::estimate_basis_cost(
+    const typename Triangulation<dim>::cell_iterator &cell) const
+  {
+    const std::vector<std::pair<double, double>> min_max =
+      MyTools::get_min_max_on_lattice<dim>(
+        {&global_parameters->lambda, &global_parameters->mu},
+        cell->vertex(0),
+        cell->vertex(GeometryInfo<dim>::vertices_per_cell - 1),
+        /* n_intervals */ 4);
+
+    // The contrast is taken for each Lamé parameter, since the ratio of
+    // lambda and mu says nothing about the variation of the material.
+    double contrast = 1.;
+    for (const std::pair<double, double> &parameter_range : min_max)
+      contrast =
+        std::max(contrast, parameter_range.second / parameter_range.first);
+
+    return std::sqrt(contrast);
   }
 
 
   template <int dim>
   void
-  ElaMs<dim>::assemble_system()
+  ElaMs<dim>::assemble_system(const LoadCase &load_case,
+                              const bool      assemble_matrix)
   {
     TimerOutput::Scope    t(computing_timer, "assembly");
     const QGauss<dim - 1> face_quadrature_formula(fe.degree + 1);
@@ -194,7 +735,7 @@ namespace Elasticity
                                        update_JxW_values);
 
     const unsigned int  n_face_q_points = face_quadrature_formula.size();
-    SurfaceForce<dim>   surface_force(global_parameters.surface_force);
+    SurfaceForce<dim>   surface_force(load_case.surface_force);
     std::vector<double> surface_force_values(n_face_q_points);
 
     const unsigned int dofs_per_cell = fe.n_dofs_per_cell();
@@ -202,6 +743,26 @@ namespace Elasticity
     Vector<double>     cell_rhs(dofs_per_cell);
     Vector<double>     cell_rhs_tmp(dofs_per_cell);
 
+    const bool affine_decomposition = global_parameters->affine_decomposition;
+
+    // The basis functions only depend on the ratio of the Lamé parameters,
+    // so the element matrices scale with the second Lamé parameter.
+    Assert(lame_scaling.has_same_ratio(basis_lame_scaling),
+           ExcMessage("The basis functions do not belong to this material."));
+    const double matrix_scaling = lame_scaling.mu / basis_lame_scaling.mu;
+
+    if (assemble_matrix)
+      {
+        if (affine_decomposition)
+          {
+            system_matrix_lambda = 0.;
+            system_matrix_mu     = 0.;
+          }
+        else
+          system_matrix = 0.;
+      }
+    system_rhs = 0.;
+
     std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
     for (const auto &cell : dof_handler.active_cell_iterators())
       {
@@ -216,8 +777,10 @@ namespace Elasticity
 
             cell_matrix = (it_basis->second).get_global_element_matrix();
             cell_rhs    = (it_basis->second).get_global_element_rhs();
+            cell_matrix *= matrix_scaling;
+            cell_rhs *= load_case.rho;
 
-            if (global_parameters.neumann_bc)
+            if (global_parameters->neumann_bc)
               {
                 for (const auto &face : cell->face_iterators())
                   if (face->at_boundary() && (face->boundary_id() == 1))
@@ -242,123 +805,116 @@ namespace Elasticity
               }
 
             cell->get_dof_indices(local_dof_indices);
-            constraints.distribute_local_to_global(cell_matrix,
-                                                   cell_rhs,
-                                                   local_dof_indices,
-                                                   system_matrix,
-                                                   system_rhs);
+            if (assemble_matrix && affine_decomposition)
+              {
+                constraints.distribute_local_to_global(
+                  (it_basis->second).get_element_matrix_lambda(),
+                  local_dof_indices,
+                  system_matrix_lambda);
+                constraints.distribute_local_to_global(
+                  (it_basis->second).get_element_matrix_mu(),
+                  local_dof_indices,
+                  system_matrix_mu);
+                constraints.distribute_local_to_global(cell_rhs,
+                                                       local_dof_indices,
+                                                       system_rhs,
+                                                       cell_matrix);
+              }
+            else if (assemble_matrix)
+              constraints.distribute_local_to_global(cell_matrix,
+                                                     cell_rhs,
+                                                     local_dof_indices,
+                                                     system_matrix,
+                                                     system_rhs);
+            else
+              constraints.distribute_local_to_global(cell_rhs,
+                                                     local_dof_indices,
+                                                     system_rhs,
+                                                     cell_matrix);
           }
       }
 
-    system_matrix.compress(VectorOperation::add);
+    if (assemble_matrix && affine_decomposition)
+      {
+        system_matrix_lambda.compress(VectorOperation::add);
+        system_matrix_mu.compress(VectorOperation::add);
+        combine_system_matrix();
+      }
+    else if (assemble_matrix)
+      system_matrix.compress(VectorOperation::add);
     system_rhs.compress(VectorOperation::add);
   }
 
 
   template <int dim>
   void
-  ElaMs<dim>::solve()
+  ElaMs<dim>::combine_system_matrix()
   {
-    if (parameters_ms.direct_solver)
-      {
-        TimerOutput::Scope t(computing_timer,
-                             "parallel sparse direct solver (MUMPS)");
-
-        if (parameters_ms.verbose)
-          {
-            pcout << "   Using direct solver..." << std::endl;
-          }
+    TimerOutput::Scope t(computing_timer, "matrix combination");
 
-        TrilinosWrappers::MPI::Vector completely_distributed_solution(
-          locally_owned_dofs, mpi_communicator);
-        SolverControl                  solver_control;
-        TrilinosWrappers::SolverDirect solver(solver_control);
+    system_matrix.copy_from(system_matrix_lambda);
+    system_matrix *= lame_scaling.lambda;
+    system_matrix.add(lame_scaling.mu, system_matrix_mu);
+  }
 
-        solver.initialize(system_matrix);
-        solver.solve(system_matrix,
-                     completely_distributed_solution,
-                     system_rhs);
 
-        if (parameters_ms.verbose)
-          {
-            pcout << "   Solved in with parallel sparse direct solver (MUMPS)."
-                  << std::endl;
-          }
+  template <int dim>
+  void
+  ElaMs<dim>::initialize_solver(const bool reuse_structure)
+  {
+    TimerOutput::Scope t(computing_timer,
+                         linear_solver.get_name() + " (setup)");
 
-        constraints.distribute(completely_distributed_solution);
+    // The factorization or the preconditioner is reused by solve() for
+    // all load cases.
+    linear_solver.initialize(system_matrix, dof_handler, reuse_structure);
 
-        locally_relevant_solution = completely_distributed_solution;
-      }
-    else
+    if (parameters_ms.verbose)
       {
-        TimerOutput::Scope t(computing_timer, "solve");
+        pcout << "   "
+              << (linear_solver.reused_structure() ? "Updated " : "Set up ")
+              << linear_solver.get_name() << "." << std::endl;
+      }
+  }
 
-        if (parameters_ms.verbose)
-          {
-            pcout << "   Using iterative solver..." << std::endl;
-          }
 
-        TrilinosWrappers::MPI::Vector completely_distributed_solution(
-          locally_owned_dofs, mpi_communicator);
-
-        unsigned int  n_iterations     = dof_handler.n_dofs();
-        const double  solver_tolerance = 1e-8 * system_rhs.l2_norm();
-        SolverControl solver_control(
-          /* n_max_iter */ n_iterations,
-          solver_tolerance,
-          /* log_history */ true,
-          /* log_result */ true);
-
-        TrilinosWrappers::SolverCG solver(solver_control);
-
-        ////////////////////////////////////////////////////////////////
-        ///////////////////////////////////
-        // TrilinosWrappers::PreconditionSSOR                 preconditioner;
-        // TrilinosWrappers::PreconditionSSOR::AdditionalData data(
-        //   /* over relaxation */ 1.2);
-        ///////////////////////////////////
-
-        ///////////////////////////////////
-        std::vector<std::vector<bool>> constant_modes;
-        FEValuesExtractors::Vector     displacement_components(0);
-        DoFTools::extract_constant_modes(dof_handler,
-                                         fe.component_mask(
-                                           displacement_components),
-                                         constant_modes);
-        TrilinosWrappers::PreconditionAMG                 preconditioner;
-        TrilinosWrappers::PreconditionAMG::AdditionalData data;
-        data.constant_modes        = constant_modes;
-        data.elliptic              = true;
-        data.higher_order_elements = false;
-        data.smoother_sweeps       = 2;
-        data.smoother_type         = "ML symmetric Gauss-Seidel";
-        data.aggregation_threshold = 0.002;
-        ///////////////////////////////////
-        ////////////////////////////////////////////////////////////////
-
-        preconditioner.initialize(system_matrix, data);
-
-        try
-          {
-            solver.solve(system_matrix,
-                         completely_distributed_solution,
-                         system_rhs,
-                         preconditioner);
-          }
-        catch (std::exception &e)
-          {
-            Assert(false, ExcMessage(e.what()));
-          }
+  template <int dim>
+  void
+  ElaMs<dim>::solve(
+    TrilinosWrappers::MPI::Vector &completely_distributed_solution)
+  {
+    // A solution of the current mesh is the initial guess of the iterative
+    // solver. The reinit is collective, so the ranks decide together.
+    const bool same_dofs =
+      (Utilities::MPI::min(
+         (completely_distributed_solution.locally_owned_elements() ==
+              locally_owned_dofs ?
+            1u :
+            0u),
+         mpi_communicator) == 1u);
+    if (!same_dofs)
+      completely_distributed_solution.reinit(locally_owned_dofs,
+                                             mpi_communicator);
+    else if (!parameters_ms.linear_solver.warm_start)
+      completely_distributed_solution = 0;
 
-        if (parameters_ms.verbose)
-          {
-            pcout << "   Solved (iteratively) in " << solver_control.last_step()
-                  << " iterations." << std::endl;
-          }
+    TimerOutput::Scope t(computing_timer,
+                         linear_solver.get_name() + " (apply)");
 
-        constraints.distribute(completely_distributed_solution);
-        locally_relevant_solution = completely_distributed_solution;
+    const unsigned int n_iterations =
+      linear_solver.solve(completely_distributed_solution, system_rhs);
+
+    if (parameters_ms.verbose)
+      {
+        if (parameters_ms.direct_solver)
+          pcout << "   Solved with " << linear_solver.get_name() << "."
+                << std::endl;
+        else
+          pcout << "   Solved (iteratively) in " << n_iterations
+                << " iterations." << std::endl;
       }
+
+    constraints.distribute(completely_distributed_solution);
   }
 
 
@@ -390,6 +946,64 @@ namespace Elasticity
   }
 
 
+  template <int dim>
+  void
+  ElaMs<dim>::get_fine_solution_at_quadrature_points(
+    std::vector<Point<dim>>     &points,
+    std::vector<double>         &JxW,
+    std::vector<Tensor<1, dim>> &values,
+    std::vector<Tensor<2, dim>> &gradients) const
+  {
+    points.clear();
+    JxW.clear();
+    values.clear();
+    gradients.clear();
+
+    for (const auto &cell_basis : cell_basis_map)
+      {
+        cell_basis.second.append_global_solution_at_quadrature_points(
+          points, JxW, values, gradients);
+      }
+  }
+
+
+  template <int dim>
+  const DoFHandler<dim> &
+  ElaMs<dim>::get_dof_handler() const
+  {
+    return dof_handler;
+  }
+
+
+  template <int dim>
+  unsigned int
+  ElaMs<dim>::get_n_basis_refinements() const
+  {
+    return parameters_basis.n_refine;
+  }
+
+
+  template <int dim>
+  void
+  ElaMs<dim>::get_basis_values_on_lattice(
+    const CellId                         &cell_id,
+    std::vector<types::global_dof_index> &dof_indices,
+    std::vector<double>                  &values) const
+  {
+    const typename DoFHandler<dim>::cell_iterator cell(
+      &triangulation,
+      cell_id.to_cell(triangulation)->level(),
+      cell_id.to_cell(triangulation)->index(),
+      &dof_handler);
+    Assert(cell->is_locally_owned(), ExcMessage("The cell is not owned."));
+
+    dof_indices.resize(fe.dofs_per_cell);
+    cell->get_dof_indices(dof_indices);
+
+    cell_basis_map.at(cell_id).get_basis_values_on_lattice(values);
+  }
+
+
   // Adaptive refinement of the grid
   template <int dim>
   void
@@ -411,8 +1025,20 @@ namespace Elasticity
 
   template <int dim>
   void
-  ElaMs<dim>::output_results(unsigned int cycle)
+  ElaMs<dim>::output_results(const unsigned int cycle,
+                             const unsigned int material,
+                             const unsigned int load_case)
   {
+    // The material and the load case are only part of the file names if
+    // there are several.
+    const std::string case_string =
+      (global_parameters->material_sweep.size() > 1 ?
+         "-mt" + Utilities::int_to_string(material, 2) :
+         "") +
+      (global_parameters->load_cases.size() > 1 ?
+         "-lc" + Utilities::int_to_string(load_case, 2) :
+         "");
+
     DataOut<dim> data_out;
     data_out.attach_dof_handler(dof_handler);
 
@@ -434,18 +1060,21 @@ namespace Elasticity
         data_out.add_data_vector(locally_relevant_solution, strain_postproc);
 
         // add the linearized stress tensor to the output
-        StressPostprocessor<dim> stress_postproc(global_parameters);
+        StressPostprocessor<dim> stress_postproc(global_parameters,
+                                                 lame_scaling);
         data_out.add_data_vector(locally_relevant_solution, stress_postproc);
 
         data_out.build_patches();
 
         // write the output files
         const std::string coarse_filename =
-          ("ms_solution-" + Utilities::int_to_string(cycle, 2) + "." +
+          ("ms_solution-" + Utilities::int_to_string(cycle, 2) + case_string +
+           "." +
            Utilities::int_to_string(triangulation.locally_owned_subdomain(),
                                     4) +
            ".vtu");
-        std::ofstream output("output/coarse/" + coarse_filename);
+        std::ofstream output(global_parameters->output_directory + "coarse/" +
+                             coarse_filename);
         data_out.write_vtu(output);
       }
 
@@ -473,7 +1102,7 @@ namespace Elasticity
 
     for (; it_basis != it_endbasis; ++it_basis)
       {
-        (it_basis->second).output_global_solution_in_cell();
+        (it_basis->second).output_global_solution_in_cell(material, load_case);
         basis_filenames.push_back((it_basis->second).get_filename());
       }
 
@@ -498,16 +1127,19 @@ namespace Elasticity
              ++i)
           if (used_processors[i])
             coarse_filenames.push_back(
-              "coarse/ms_solution-" + Utilities::int_to_string(cycle, 2) + "." +
-              Utilities::int_to_string(i, 4) + ".vtu");
+              "coarse/ms_solution-" + Utilities::int_to_string(cycle, 2) +
+              case_string + "." + Utilities::int_to_string(i, 4) + ".vtu");
 
-        std::ofstream master_output(
-          "output/ms_solution" + Utilities::int_to_string(cycle, 2) + ".pvtu");
+        std::ofstream master_output(global_parameters->output_directory +
+                                    "ms_solution" +
+                                    Utilities::int_to_string(cycle, 2) +
+                                    case_string + ".pvtu");
         data_out.write_pvtu_record(master_output, coarse_filenames);
 
-        std::ofstream fine_master_output("output/fine_ms_solution" +
+        std::ofstream fine_master_output(global_parameters->output_directory +
+                                         "fine_ms_solution" +
                                          Utilities::int_to_string(cycle, 2) +
-                                         ".pvtu");
+                                         case_string + ".pvtu");
         data_out.write_pvtu_record(fine_master_output, ordered_basis_filenames);
       }
   }
@@ -515,7 +1147,7 @@ namespace Elasticity
 
   template <int dim>
   void
-  ElaMs<dim>::run()
+  ElaMs<dim>::run(const bool write_output)
   {
     if (parameters_ms.verbose)
       {
@@ -525,7 +1157,15 @@ namespace Elasticity
               << " MPI rank(s)..." << std::endl;
       }
 
-    for (unsigned int cycle = 0; cycle < 1; ++cycle)
+    // The coarse mesh is the same in all cycles, so the solutions of the
+    // last cycle (or material) are the initial guesses of the solver,
+    // unless a repartition has renumbered the dofs.
+    const std::vector<LoadCase> solved_load_cases =
+      global_parameters->get_solved_load_cases();
+    std::vector<TrilinosWrappers::MPI::Vector> solutions(
+      solved_load_cases.size());
+
+    for (unsigned int cycle = 0; cycle < parameters_ms.n_cycles; ++cycle)
       {
         if (parameters_ms.verbose)
           {
@@ -534,8 +1174,8 @@ namespace Elasticity
 
         if (cycle == 0)
           {
-            const Point<dim> p1 = global_parameters.init_p1,
-                             p2 = global_parameters.init_p2;
+            const Point<dim> p1 = global_parameters->init_p1,
+                             p2 = global_parameters->init_p2;
 
             const std::vector<unsigned int> repetitions =
               MyTools::get_repetitions(p1, p2);
@@ -545,15 +1185,30 @@ namespace Elasticity
 
             // GridGenerator::cylinder(triangulation, 10., 0.1);
 
-            triangulation.refine_global(global_parameters.coarse_refinements);
+            triangulation.refine_global(parameters_ms.n_refine);
           }
         else
           {
             ++parameters_basis.n_refine;
           }
 
+        // The first partition can only be weighted with the estimated
+        // costs, the later ones with the costs of the last cycle.
+        const bool repartition =
+          (parameters_ms.weighted_partitioning &&
+           (cycle > 0 || parameters_ms.a_priori_weights));
+        if (repartition)
+          {
+            TimerOutput::Scope t(computing_timer, "repartition");
+            triangulation.repartition();
+          }
+
         setup_system();
 
+        if (repartition)
+          for (TrilinosWrappers::MPI::Vector &solution : solutions)
+            solution.reinit(locally_owned_dofs, mpi_communicator);
+
         if (parameters_ms.verbose)
           {
             pcout << "   Number of active cells:       "
@@ -562,18 +1217,84 @@ namespace Elasticity
                   << std::endl;
           }
 
-        initialize_and_compute_basis(cycle);
+        for (unsigned int material = 0;
+             material < global_parameters->material_sweep.size();
+             ++material)
+          {
+            if (parameters_ms.verbose &&
+                global_parameters->material_sweep.size() > 1)
+              {
+                pcout << "   Material " << material << ':' << std::endl;
+              }
 
-        assemble_system();
+            lame_scaling = global_parameters->material_sweep[material];
 
-        solve();
+            // The basis functions only depend on the ratio of the Lamé
+            // parameters and are only recomputed if it changes.
+            const bool compute_basis =
+              (material == 0 ||
+               !lame_scaling.has_same_ratio(basis_lame_scaling));
+            if (compute_basis)
+              {
+                basis_lame_scaling = lame_scaling;
+                initialize_and_compute_basis(cycle);
+              }
 
-        send_global_weights_to_cell();
+            // With the affine decomposition, the system matrix of a new
+            // material is only a combination of the stored matrices.
+            const bool assemble_matrix =
+              (compute_basis || !global_parameters->affine_decomposition);
+            if (!assemble_matrix)
+              combine_system_matrix();
+
+            // The system matrix is assembled and factorized (or
+            // preconditioned) once, afterwards only the right-hand side
+            // changes.
+            for (unsigned int i = 0; i < solved_load_cases.size(); ++i)
+              {
+                if (parameters_ms.verbose && solved_load_cases.size() > 1)
+                  {
+                    pcout << "   Load case " << i << ':' << std::endl;
+                  }
+
+                setup_constraints(solved_load_cases[i]);
+                assemble_system(solved_load_cases[i],
+                                /* assemble_matrix */ assemble_matrix &&
+                                  i == 0);
+
+                // Only the entries of the system matrix differ between
+                // the materials.
+                if (i == 0)
+                  initialize_solver(/* reuse_structure */ material > 0);
+
+                solve(solutions[i]);
+              }
 
-        {
-          TimerOutput::Scope t(computing_timer, "output");
-          output_results(cycle);
-        }
+            for (unsigned int load_case = 0;
+                 load_case < global_parameters->load_cases.size();
+                 ++load_case)
+              {
+                const std::vector<double> weights =
+                  global_parameters->get_superposition_weights(load_case);
+
+                TrilinosWrappers::MPI::Vector completely_distributed_solution(
+                  locally_owned_dofs, mpi_communicator);
+                for (unsigned int i = 0; i < solutions.size(); ++i)
+                  if (weights[i] != 0.)
+                    completely_distributed_solution.add(weights[i],
+                                                        solutions[i]);
+
+                locally_relevant_solution = completely_distributed_solution;
+
+                send_global_weights_to_cell();
+
+                if (write_output)
+                  {
+                    TimerOutput::Scope t(computing_timer, "output");
+                    output_results(cycle, material, load_case);
+                  }
+              }
+          }
 
         computing_timer.print_summary();
         computing_timer.reset();
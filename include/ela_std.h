@@ -2,6 +2,7 @@
 #ifndef _INCLUDE_ELA_STD_H_
 #define _INCLUDE_ELA_STD_H_
 
+#include <deal.II/base/bounding_box.h>
 #include <deal.II/base/conditional_ostream.h>
 #include <deal.II/base/function.h>
 #include <deal.II/base/index_set.h>
@@ -12,6 +13,7 @@
 #include <deal.II/base/utilities.h>
 
 #include <deal.II/distributed/grid_refinement.h>
+#include <deal.II/distributed/solution_transfer.h>
 #include <deal.II/distributed/tria.h>
 
 #include <deal.II/dofs/dof_handler.h>
@@ -21,8 +23,10 @@
 #include <deal.II/fe/fe_system.h>
 #include <deal.II/fe/fe_values.h>
 
+#include <deal.II/grid/filtered_iterator.h>
 #include <deal.II/grid/grid_generator.h>
 #include <deal.II/grid/grid_tools.h>
+#include <deal.II/grid/grid_tools_cache.h>
 
 #include <deal.II/lac/affine_constraints.h>
 #include <deal.II/lac/dynamic_sparsity_pattern.h>
@@ -44,15 +48,18 @@
 #include <deal.II/physics/transformations.h>
 
 #include "forces_and_lame_parameters.h"
+#include "linear_solver.h"
 #include "mytools.h"
 #include "postprocessing.h"
 #include "process_parameter_file.h"
+#include "two_level_schwarz.h"
 
 // STL
 #include <cmath>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 
 
 namespace Elasticity
@@ -82,23 +89,94 @@ namespace Elasticity
     /**
      * @brief Construct a new ElaStd object.
      *
-     * @param global_parameters Parameters that many classes need.
+     * @param global_parameters Shared handle to the parameters that many
+     *                          classes need.
      * @param parameters_std Parameters that only this class needs.
+     * @param mpi_communicator The MPI communicator
      */
-    ElaStd(const GlobalParameters<dim> &global_parameters,
-           const ParametersStd &        parameters_std);
+    ElaStd(
+      const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+      const ParametersStd &                               parameters_std,
+      const MPI_Comm mpi_communicator = MPI_COMM_WORLD);
 
     /**
      * @brief Function that runs the problem.
      *
+     * @param write_output If false, no vtu files are written.
+     *
      * This function first refines the problem
      * and then runs all the member functions
      * that are necessary to solve the problem and
      * repeats this for a number of times specified
      * in the parameter file.
+     *
+     * The first cycle uses ParametersStd::n_refine global refinements,
+     * every further cycle refines the mesh once more.
+     */
+    void
+    run(const bool write_output = true);
+
+    /**
+     * @brief Evaluates the last solution of run() at arbitrary points.
+     *
+     * @param points Points at which this rank needs the solution. They
+     *               do not have to lie in locally owned cells.
+     * @param values Displacement at the points
+     * @param gradients Gradient of the displacement at the points
+     *
+     * The points are located in the distributed mesh with
+     * GridTools::distributed_compute_point_locations(). The owner of the
+     * cell that contains a point evaluates the solution there and sends
+     * the result back. This function is collective on the communicator of
+     * this object and all points must lie in the domain.
+     */
+    void
+    evaluate_solution(const std::vector<Point<dim>> &points,
+                      std::vector<Tensor<1, dim>> &  values,
+                      std::vector<Tensor<2, dim>> &  gradients) const;
+
+    /**
+     * @brief Runs an ensemble of material samples.
+     *
+     * @param seeds Seeds of the material samples that are computed on
+     *              this communicator
+     * @param sample_filename Name of the csv file that receives one line
+     *                        per sample
+     * @return std::vector<MyTools::RunningStatistics> Statistics of the
+     *         quantities of interest, see get_ensemble_quantity_names()
+     *
+     * The mesh, the DoFHandler, the sparsity pattern and the structural
+     * part of the solver setup (symbolic factorization or ML aggregates)
+     * are set up once and reused for all samples. Only the first load case
+     * is computed and no vtu files are written.
+     *
+     * @see GlobalParameters::draw_material_sample()
+     */
+    std::vector<MyTools::RunningStatistics>
+    run_ensemble(const std::vector<unsigned int> &seeds,
+                 const std::string &              sample_filename);
+
+    /**
+     * @brief Returns the names of the quantities of interest of
+     *        run_ensemble().
+     *
+     * @return std::vector<std::string>
+     */
+    static std::vector<std::string>
+    get_ensemble_quantity_names();
+
+    /**
+     * @brief Sets the MsFEM whose basis functions are the coarse space of
+     *        the two-level Schwarz preconditioner.
+     *
+     * @param ela_ms ElaMs after run(). It must outlive this object.
+     *
+     * Only used with ParametersStd::two_level_schwarz. In cycles in which
+     * the fine mesh does not match the mesh of the basis functions, the
+     * #linear_solver is used instead.
      */
     void
-    run();
+    set_coarse_space(const ElaMs<dim> &ela_ms);
 
   private:
     /**
@@ -114,26 +192,72 @@ namespace Elasticity
     void
     setup_system();
 
+    /**
+     * @brief Sets up the constraints of a load case.
+     *
+     * @param load_case The load case
+     *
+     * All load cases constrain the same degrees of freedom, only the
+     * values of the rotation differ.
+     */
+    void
+    setup_constraints(const LoadCase &load_case);
+
     /**
      * @brief Assembles the system.
      *
+     * @param load_case The load case for which the #system_rhs is assembled
+     * @param assemble_matrix True if the #system_matrix shall be assembled
+     *
      * This function assembles the #system_matrix and the #system_rhs
-     * for linear elasticity problems.
+     * for linear elasticity problems. The cell matrices are only
+     * computed if the #system_matrix is assembled or if they are needed
+     * for inhomogeneous constraints.
+     *
+     * With GlobalParameters::affine_decomposition, the matrices
+     * #system_matrix_lambda and #system_matrix_mu are assembled instead
+     * and combined into the #system_matrix.
+     */
+    void
+    assemble_system(const LoadCase &load_case, const bool assemble_matrix);
+
+    /**
+     * @brief Combines #system_matrix_lambda and #system_matrix_mu
+     *        into the #system_matrix with the scalings of #lame_scaling.
      */
     void
-    assemble_system();
+    combine_system_matrix();
+
+    /**
+     * @brief Factorizes the #system_matrix or sets up the preconditioner.
+     *
+     * @param reuse_structure If true, only the entries of the
+     *                        #system_matrix have changed since the last
+     *                        call, see LinearSolver::initialize().
+     *
+     * The solver is chosen in #parameters_std, see LinearSolver. The result is
+     * reused by solve() for all load cases.
+     *
+     * With ParametersStd::two_level_schwarz and a matching #coarse_space,
+     * the #schwarz_preconditioner replaces the #linear_solver.
+     */
+    void
+    initialize_solver(const bool reuse_structure = false);
 
     /**
      * @brief Solves the problem.
      *
-     * This function solves the problem.
+     * @param completely_distributed_solution Vector for the solution
+     *
+     * This function solves the problem with the #system_rhs and the
+     * solver set up in initialize_solver().
      *
-     * In #parameters_std, it can be specified if a direct
-     * or iterative (CG-method with AMG preconditioner) shall
-     * be used.
+     * If the vector is already a vector of the locally owned dofs, it is
+     * the initial guess of the iterative solver (see
+     * ParametersSolver::warm_start), otherwise it is initialized with zero.
      */
     void
-    solve();
+    solve(TrilinosWrappers::MPI::Vector &completely_distributed_solution);
 
     /**
      * @brief Adaptively refines grid.
@@ -149,24 +273,40 @@ namespace Elasticity
      * For this, it creates vtu files for every subdomain
      * (corresponding to the respective processor) and combines them into
      * a single pvtu file.
+     *
+     * @param cycle The refinement cycle
+     * @param material Index of the material in
+     *                 GlobalParameters::material_sweep
+     * @param load_case Index of the load case in GlobalParameters::load_cases
      */
     void
-    output_results(const unsigned int cycle) const;
-
-    MPI_Comm                                  mpi_communicator;
-    parallel::distributed::Triangulation<dim> triangulation;
-    FESystem<dim>                             fe;
-    DoFHandler<dim>                           dof_handler;
-    IndexSet                                  locally_owned_dofs;
-    IndexSet                                  locally_relevant_dofs;
-    AffineConstraints<double>                 constraints;
-    TrilinosWrappers::SparseMatrix            system_matrix;
-    TrilinosWrappers::SparseMatrix            preconditioner_matrix;
-    TrilinosWrappers::MPI::Vector             locally_relevant_solution;
-    TrilinosWrappers::MPI::Vector             system_rhs;
-    const GlobalParameters<dim>               global_parameters;
-    const ParametersStd                       parameters_std;
-    bool                                      processor_is_used;
+    output_results(const unsigned int cycle,
+                   const unsigned int material,
+                   const unsigned int load_case) const;
+
+    MPI_Comm                                           mpi_communicator;
+    parallel::distributed::Triangulation<dim>          triangulation;
+    FESystem<dim>                                      fe;
+    DoFHandler<dim>                                    dof_handler;
+    IndexSet                                           locally_owned_dofs;
+    IndexSet                                           locally_relevant_dofs;
+    AffineConstraints<double>                          constraints;
+    TrilinosWrappers::SparseMatrix                     system_matrix;
+    TrilinosWrappers::SparseMatrix                     system_matrix_lambda;
+    TrilinosWrappers::SparseMatrix                     system_matrix_mu;
+    TrilinosWrappers::SparseMatrix                     preconditioner_matrix;
+    TrilinosWrappers::MPI::Vector                      locally_relevant_solution;
+    TrilinosWrappers::MPI::Vector                      system_rhs;
+    LinearSolver<dim>                                  linear_solver;
+    TwoLevelSchwarzPreconditioner<dim>                 schwarz_preconditioner;
+    bool                                               use_schwarz;
+    /**< True if the #schwarz_preconditioner is set up for this mesh. */
+
+    const ElaMs<dim> *                                 coarse_space;
+    std::shared_ptr<const GlobalParameters<dim>>       global_parameters;
+    const ParametersStd                                parameters_std;
+    LameScaling                                        lame_scaling;
+    bool                                               processor_is_used;
     /**< True if this processor is assigned at least one coarse cell. */
 
     ConditionalOStream pcout;
@@ -12,17 +12,24 @@ namespace Elasticity
 
   // The constructor
   template <int dim>
-  ElaStd<dim>::ElaStd(const GlobalParameters<dim> &global_parameters,
-                      const ParametersStd         &parameters_std)
-    : mpi_communicator(MPI_COMM_WORLD)
+  ElaStd<dim>::ElaStd(
+    const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+    const ParametersStd                                &parameters_std,
+    const MPI_Comm                                      mpi_communicator)
+    : mpi_communicator(mpi_communicator)
     , triangulation(mpi_communicator,
                     typename Triangulation<dim>::MeshSmoothing(
                       Triangulation<dim>::smoothing_on_refinement |
                       Triangulation<dim>::smoothing_on_coarsening))
     , fe(FE_Q<dim>(1), dim)
     , dof_handler(triangulation)
+    , linear_solver(parameters_std.linear_solver)
+    , schwarz_preconditioner(mpi_communicator)
+    , use_schwarz(false)
+    , coarse_space(nullptr)
     , global_parameters(global_parameters)
     , parameters_std(parameters_std)
+    , lame_scaling(global_parameters->material_sweep[0])
     , processor_is_used(false)
     , pcout(std::cout,
             (Utilities::MPI::this_mpi_process(mpi_communicator) == 0))
@@ -45,42 +52,20 @@ namespace Elasticity
                                      locally_relevant_dofs,
                                      mpi_communicator);
     system_rhs.reinit(locally_owned_dofs, mpi_communicator);
-    constraints.clear();
-    constraints.reinit(locally_relevant_dofs);
-    DoFTools::make_hanging_node_constraints(dof_handler, constraints);
-    unsigned int dirichlet_id = 0;
 
     // The next part is used if a Dirichlet boundary condition is only applied
     // on a part of a face.
 
-    if (global_parameters.other_dirichlet_id)
+    if (global_parameters->other_dirichlet_id)
       {
-        const Point<dim> p1(global_parameters.dirichlet_p1),
-          p2(global_parameters.dirichlet_p2);
+        const Point<dim> p1(global_parameters->dirichlet_p1),
+          p2(global_parameters->dirichlet_p2);
         MyTools::set_dirichlet_id<dim>(p1, p2, 4, 100, triangulation);
-        dirichlet_id = 100;
       }
 
-    VectorTools::interpolate_boundary_values(dof_handler,
-                                             dirichlet_id,
-                                             Functions::ZeroFunction<dim>(dim),
-                                             constraints);
+    // The constrained degrees of freedom are the same for all load cases.
+    setup_constraints(global_parameters->load_cases[0]);
 
-    if (dim == 3)
-      {
-        if (global_parameters.rotate)
-          {
-            VectorTools::interpolate_boundary_values(
-              dof_handler,
-              1,
-              MyTools::Rotation<dim>(global_parameters.init_p1,
-                                     global_parameters.init_p2,
-                                     global_parameters.angle),
-              constraints);
-          }
-      }
-
-    constraints.close();
     DynamicSparsityPattern dsp(locally_relevant_dofs);
     DoFTools::make_sparsity_pattern(dof_handler, dsp, constraints, false);
     SparsityTools::distribute_sparsity_pattern(
@@ -94,12 +79,21 @@ namespace Elasticity
                          dsp,
                          mpi_communicator);
 
+    if (global_parameters->affine_decomposition)
+      {
+        system_matrix_lambda.reinit(system_matrix);
+        system_matrix_mu.reinit(system_matrix);
+      }
+
     // std::filesystem::create_directories("output/std_partitioned");
 
     try
       {
-        MyTools::create_data_directory("output/");
-        MyTools::create_data_directory("output/std_partitioned/");
+        const std::string &output_directory =
+          global_parameters->output_directory;
+        MyTools::create_data_directory(output_directory.c_str());
+        MyTools::create_data_directory(
+          (output_directory + "std_partitioned/").c_str());
       }
     catch (std::runtime_error &e)
       {
@@ -113,7 +107,42 @@ namespace Elasticity
 
   template <int dim>
   void
-  ElaStd<dim>::assemble_system()
+  ElaStd<dim>::setup_constraints(const LoadCase &load_case)
+  {
+    constraints.clear();
+    constraints.reinit(locally_relevant_dofs);
+    DoFTools::make_hanging_node_constraints(dof_handler, constraints);
+
+    const unsigned int dirichlet_id =
+      (global_parameters->other_dirichlet_id ? 100 : 0);
+
+    VectorTools::interpolate_boundary_values(dof_handler,
+                                             dirichlet_id,
+                                             Functions::ZeroFunction<dim>(dim),
+                                             constraints);
+
+    if (dim == 3)
+      {
+        if (global_parameters->rotate)
+          {
+            VectorTools::interpolate_boundary_values(
+              dof_handler,
+              1,
+              MyTools::Rotation<dim>(global_parameters->init_p1,
+                                     global_parameters->init_p2,
+                                     load_case.angle),
+              constraints);
+          }
+      }
+
+    constraints.close();
+  }
+
+
+  template <int dim>
+  void
+  ElaStd<dim>::assemble_system(const LoadCase &load_case,
+                               const bool      assemble_matrix)
   {
     TimerOutput::Scope    t(computing_timer, "assembly");
     const QGauss<dim>     quadrature_formula(fe.degree + 1);
@@ -134,25 +163,50 @@ namespace Elasticity
     std::vector<Vector<double>> body_force_values(n_q_points);
     for (unsigned int i = 0; i < n_q_points; ++i)
       body_force_values[i].reinit(dim);
-    BodyForce<dim>     body_force(global_parameters.rho);
-    SurfaceForce<dim>  surface_force(global_parameters.surface_force);
+    BodyForce<dim>     body_force(load_case.rho);
+    SurfaceForce<dim>  surface_force(load_case.surface_force);
     FullMatrix<double> cell_matrix(dofs_per_cell, dofs_per_cell);
+    FullMatrix<double> cell_matrix_lambda(dofs_per_cell, dofs_per_cell);
+    FullMatrix<double> cell_matrix_mu(dofs_per_cell, dofs_per_cell);
     Vector<double>     cell_rhs(dofs_per_cell);
     Vector<double>     cell_rhs_tmp(dofs_per_cell);
 
+    const bool affine_decomposition = global_parameters->affine_decomposition;
+
+    // The cell matrices are needed for the right-hand side if the
+    // constraints are inhomogeneous.
+    const bool compute_cell_matrix =
+      assemble_matrix || constraints.has_inhomogeneities();
+
+    if (assemble_matrix)
+      {
+        if (affine_decomposition)
+          {
+            system_matrix_lambda = 0.;
+            system_matrix_mu     = 0.;
+          }
+        else
+          system_matrix = 0.;
+      }
+    system_rhs = 0.;
+
     std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
     for (const auto &cell : dof_handler.active_cell_iterators())
       {
         if (cell->is_locally_owned())
           {
-            processor_is_used = true;
-            cell_matrix       = 0.;
-            cell_rhs          = 0.;
+            processor_is_used  = true;
+            cell_matrix_lambda = 0.;
+            cell_matrix_mu     = 0.;
+            cell_rhs           = 0.;
             fe_values.reinit(cell);
-            global_parameters.lambda.value_list(
-              fe_values.get_quadrature_points(), lambda_values);
-            global_parameters.mu.value_list(fe_values.get_quadrature_points(),
-                                            mu_values);
+            if (compute_cell_matrix)
+              {
+                global_parameters->lambda.value_list(
+                  fe_values.get_quadrature_points(), lambda_values);
+                global_parameters->mu.value_list(
+                  fe_values.get_quadrature_points(), mu_values);
+              }
             body_force.vector_value_list(fe_values.get_quadrature_points(),
                                          body_force_values);
             for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
@@ -161,23 +215,24 @@ namespace Elasticity
                   {
                     const unsigned int component_i =
                       fe.system_to_component_index(i).first;
-                    for (unsigned int j = 0; j < fe.dofs_per_cell; ++j)
+                    for (unsigned int j = 0;
+                         compute_cell_matrix && j < fe.dofs_per_cell;
+                         ++j)
                       {
                         const unsigned int component_j =
                           fe.system_to_component_index(j).first;
-                        cell_matrix(i, j) +=
-                          ((fe_values.shape_grad(i, q_point)[component_i] *
-                            fe_values.shape_grad(j, q_point)[component_j] *
-                            lambda_values[q_point]) +
-                           (fe_values.shape_grad(i, q_point)[component_j] *
-                            fe_values.shape_grad(j, q_point)[component_i] *
-                            mu_values[q_point]) +
+                        cell_matrix_lambda(i, j) +=
+                          fe_values.shape_grad(i, q_point)[component_i] *
+                          fe_values.shape_grad(j, q_point)[component_j] *
+                          lambda_values[q_point] * fe_values.JxW(q_point);
+                        cell_matrix_mu(i, j) +=
+                          ((fe_values.shape_grad(i, q_point)[component_j] *
+                            fe_values.shape_grad(j, q_point)[component_i]) +
                            ((component_i == component_j) ?
                               (fe_values.shape_grad(i, q_point) *
-                               fe_values.shape_grad(j, q_point) *
-                               mu_values[q_point]) :
+                               fe_values.shape_grad(j, q_point)) :
                               0)) *
-                          fe_values.JxW(q_point);
+                          mu_values[q_point] * fe_values.JxW(q_point);
                       }
                     cell_rhs(i) +=
                       fe_values.shape_value_component(i, q_point, component_i) *
@@ -191,7 +246,7 @@ namespace Elasticity
                   }
                 cell_rhs_tmp = cell_rhs;
               }
-            if (global_parameters.neumann_bc)
+            if (global_parameters->neumann_bc)
               {
                 for (const auto &face : cell->face_iterators())
                   if (face->at_boundary() && (face->boundary_id() == 1))
@@ -215,124 +270,174 @@ namespace Elasticity
                     }
               }
 
+            if (compute_cell_matrix)
+              cell_matrix.equ(lame_scaling.lambda,
+                              cell_matrix_lambda,
+                              lame_scaling.mu,
+                              cell_matrix_mu);
+
             cell->get_dof_indices(local_dof_indices);
-            constraints.distribute_local_to_global(cell_matrix,
-                                                   cell_rhs,
-                                                   local_dof_indices,
-                                                   system_matrix,
-                                                   system_rhs);
+            if (assemble_matrix && affine_decomposition)
+              {
+                constraints.distribute_local_to_global(cell_matrix_lambda,
+                                                       local_dof_indices,
+                                                       system_matrix_lambda);
+                constraints.distribute_local_to_global(cell_matrix_mu,
+                                                       local_dof_indices,
+                                                       system_matrix_mu);
+                constraints.distribute_local_to_global(cell_rhs,
+                                                       local_dof_indices,
+                                                       system_rhs,
+                                                       cell_matrix);
+              }
+            else if (assemble_matrix)
+              constraints.distribute_local_to_global(cell_matrix,
+                                                     cell_rhs,
+                                                     local_dof_indices,
+                                                     system_matrix,
+                                                     system_rhs);
+            else if (compute_cell_matrix)
+              constraints.distribute_local_to_global(cell_rhs,
+                                                     local_dof_indices,
+                                                     system_rhs,
+                                                     cell_matrix);
+            else
+              constraints.distribute_local_to_global(cell_rhs,
+                                                     local_dof_indices,
+                                                     system_rhs);
           }
       }
-    system_matrix.compress(VectorOperation::add);
+    if (assemble_matrix && affine_decomposition)
+      {
+        system_matrix_lambda.compress(VectorOperation::add);
+        system_matrix_mu.compress(VectorOperation::add);
+        combine_system_matrix();
+      }
+    else if (assemble_matrix)
+      system_matrix.compress(VectorOperation::add);
     system_rhs.compress(VectorOperation::add);
   }
 
 
   template <int dim>
   void
-  ElaStd<dim>::solve()
+  ElaStd<dim>::combine_system_matrix()
   {
-    if (parameters_std.direct_solver)
-      {
-        TimerOutput::Scope t(computing_timer,
-                             "parallel sparse direct solver (MUMPS)");
+    TimerOutput::Scope t(computing_timer, "matrix combination");
 
-        if (parameters_std.verbose)
-          {
-            pcout << "   Using direct solver..." << std::endl;
-          }
+    system_matrix.copy_from(system_matrix_lambda);
+    system_matrix *= lame_scaling.lambda;
+    system_matrix.add(lame_scaling.mu, system_matrix_mu);
+  }
 
-        TrilinosWrappers::MPI::Vector completely_distributed_solution(
-          locally_owned_dofs, mpi_communicator);
-        SolverControl                  solver_control;
-        TrilinosWrappers::SolverDirect solver(solver_control);
-        solver.initialize(system_matrix);
-        solver.solve(system_matrix,
-                     completely_distributed_solution,
-                     system_rhs);
+
+  template <int dim>
+  void
+  ElaStd<dim>::initialize_solver(const bool reuse_structure)
+  {
+    use_schwarz =
+      !parameters_std.direct_solver && parameters_std.two_level_schwarz &&
+      coarse_space != nullptr &&
+      TwoLevelSchwarzPreconditioner<dim>::is_compatible(dof_handler,
+                                                        *coarse_space);
+
+    if (use_schwarz)
+      {
+        TimerOutput::Scope t(computing_timer,
+                             "CG with two-level Schwarz (setup)");
 
         if (parameters_std.verbose)
           {
-            pcout << "   Solved in with parallel sparse direct solver (MUMPS)."
+            pcout << "   Using CG with two-level Schwarz preconditioner..."
                   << std::endl;
           }
 
+        schwarz_preconditioner.initialize(system_matrix,
+                                          dof_handler,
+                                          constraints,
+                                          *coarse_space);
+        return;
+      }
 
-        constraints.distribute(completely_distributed_solution);
+    TimerOutput::Scope t(computing_timer,
+                         linear_solver.get_name() + " (setup)");
 
-        locally_relevant_solution = completely_distributed_solution;
-      }
-    else
-      {
-        TimerOutput::Scope t(computing_timer, "solve");
+    // The factorization or the preconditioner is reused by solve() for
+    // all load cases.
+    linear_solver.initialize(system_matrix, dof_handler, reuse_structure);
 
-        if (parameters_std.verbose)
-          {
-            pcout << "   Using iterative solver..." << std::endl;
-          }
+    if (parameters_std.verbose)
+      {
+        pcout << "   "
+              << (linear_solver.reused_structure() ? "Updated " : "Set up ")
+              << linear_solver.get_name() << "." << std::endl;
+      }
+  }
 
 
-        TrilinosWrappers::MPI::Vector completely_distributed_solution(
-          locally_owned_dofs, mpi_communicator);
+  template <int dim>
+  void
+  ElaStd<dim>::solve(
+    TrilinosWrappers::MPI::Vector &completely_distributed_solution)
+  {
+    // A solution of the current mesh is the initial guess of the iterative
+    // solver.
+    if (completely_distributed_solution.locally_owned_elements() !=
+        locally_owned_dofs)
+      completely_distributed_solution.reinit(locally_owned_dofs,
+                                             mpi_communicator);
+    else if (!parameters_std.linear_solver.warm_start)
+      completely_distributed_solution = 0;
+
+    unsigned int n_iterations = 0;
+    if (use_schwarz)
+      {
+        TimerOutput::Scope t(computing_timer,
+                             "CG with two-level Schwarz (apply)");
 
-        unsigned int  n_iterations     = dof_handler.n_dofs();
         const double  solver_tolerance = 1e-8 * system_rhs.l2_norm();
         SolverControl solver_control(
-          /* n_max_iter */ n_iterations,
+          /* n_max_iter */ dof_handler.n_dofs(),
           solver_tolerance,
           /* log_history */ true,
           /* log_result */ true);
 
-        TrilinosWrappers::SolverCG solver(solver_control);
-
-        ////////////////////////////////////////////////////////////////
-        ///////////////////////////////////
-        // TrilinosWrappers::PreconditionSSOR                 preconditioner;
-        // TrilinosWrappers::PreconditionSSOR::AdditionalData data(
-        //   /* over relaxation */ 1.2);
-        ///////////////////////////////////
-
-        ///////////////////////////////////
-        std::vector<std::vector<bool>> constant_modes;
-        FEValuesExtractors::Vector     displacement_components(0);
-        DoFTools::extract_constant_modes(dof_handler,
-                                         fe.component_mask(
-                                           displacement_components),
-                                         constant_modes);
-        TrilinosWrappers::PreconditionAMG                 preconditioner;
-        TrilinosWrappers::PreconditionAMG::AdditionalData data;
-        data.constant_modes        = constant_modes;
-        data.elliptic              = true;
-        data.higher_order_elements = false;
-        data.smoother_sweeps       = 2;
-        data.smoother_type         = "ML symmetric Gauss-Seidel";
-        data.aggregation_threshold = 0.002;
-        ///////////////////////////////////
-        ////////////////////////////////////////////////////////////////
-
-        preconditioner.initialize(system_matrix, data);
+        SolverCG<TrilinosWrappers::MPI::Vector> solver(solver_control);
 
         try
           {
             solver.solve(system_matrix,
                          completely_distributed_solution,
                          system_rhs,
-                         preconditioner);
+                         schwarz_preconditioner);
           }
         catch (std::exception &e)
           {
             Assert(false, ExcMessage(e.what()));
           }
 
-        if (parameters_std.verbose)
-          {
-            pcout << "   Solved (iteratively) in " << solver_control.last_step()
-                  << " iterations." << std::endl;
-          }
+        n_iterations = solver_control.last_step();
+      }
+    else
+      {
+        TimerOutput::Scope t(computing_timer,
+                             linear_solver.get_name() + " (apply)");
 
-        constraints.distribute(completely_distributed_solution);
-        locally_relevant_solution = completely_distributed_solution;
+        n_iterations =
+          linear_solver.solve(completely_distributed_solution, system_rhs);
       }
+
+    if (parameters_std.verbose)
+      {
+        if (parameters_std.direct_solver)
+          pcout << "   Solved with " << linear_solver.get_name() << "."
+                << std::endl;
+        else
+          pcout << "   Solved (iteratively) in " << n_iterations
+                << " iterations." << std::endl;
+      }
+
+    constraints.distribute(completely_distributed_solution);
   }
 
 
@@ -357,21 +462,34 @@ namespace Elasticity
 
   template <int dim>
   void
-  ElaStd<dim>::output_results(const unsigned int cycle) const
+  ElaStd<dim>::output_results(const unsigned int cycle,
+                              const unsigned int material,
+                              const unsigned int load_case) const
   {
+    // The material and the load case are only part of the file names if
+    // there are several.
+    const std::string solution_name =
+      "std_solution-" + Utilities::int_to_string(cycle, 2) +
+      (global_parameters->material_sweep.size() > 1 ?
+         "-mt" + Utilities::int_to_string(material, 2) :
+         "") +
+      (global_parameters->load_cases.size() > 1 ?
+         "-lc" + Utilities::int_to_string(load_case, 2) :
+         "");
+
     DataOut<dim> data_out;
     data_out.attach_dof_handler(dof_handler);
 
     if (processor_is_used)
       {
         // add the displacement to the output
-        std::vector<std::string> solution_name(dim, "displacement");
+        std::vector<std::string> component_names(dim, "displacement");
         std::vector<DataComponentInterpretation::DataComponentInterpretation>
           interpretation(
             dim, DataComponentInterpretation::component_is_part_of_vector);
 
         data_out.add_data_vector(locally_relevant_solution,
-                                 solution_name,
+                                 component_names,
                                  DataOut<dim>::type_dof_data,
                                  interpretation);
 
@@ -380,15 +498,16 @@ namespace Elasticity
         data_out.add_data_vector(locally_relevant_solution, strain_postproc);
 
         // add the linearized stress tensor to the output
-        StressPostprocessor<dim> stress_postproc(global_parameters);
+        StressPostprocessor<dim> stress_postproc(global_parameters,
+                                                 lame_scaling);
         data_out.add_data_vector(locally_relevant_solution, stress_postproc);
 
         data_out.build_patches();
 
         // write the output files
         const std::string filename =
-          ("output/std_partitioned/std_solution-" +
-           Utilities::int_to_string(cycle, 2) + "." +
+          (global_parameters->output_directory + "std_partitioned/" +
+           solution_name + "." +
            Utilities::int_to_string(triangulation.locally_owned_subdomain(),
                                     4) +
            ".vtu");
@@ -420,13 +539,11 @@ namespace Elasticity
              i < Utilities::MPI::n_mpi_processes(mpi_communicator);
              ++i)
           if (used_processors[i])
-            filenames.push_back("std_partitioned/std_solution-" +
-                                Utilities::int_to_string(cycle, 2) + "." +
+            filenames.push_back("std_partitioned/" + solution_name + "." +
                                 Utilities::int_to_string(i, 4) + ".vtu");
 
-        std::ofstream master_output("output/std_solution-" +
-                                    Utilities::int_to_string(cycle, 2) +
-                                    ".pvtu");
+        std::ofstream master_output(global_parameters->output_directory +
+                                    solution_name + ".pvtu");
         data_out.write_pvtu_record(master_output, filenames);
       }
   }
@@ -434,7 +551,7 @@ namespace Elasticity
 
   template <int dim>
   void
-  ElaStd<dim>::run()
+  ElaStd<dim>::run(const bool write_output)
   {
     if (parameters_std.verbose)
       {
@@ -445,16 +562,28 @@ namespace Elasticity
       }
 
 
-    const Point<dim> p1 = global_parameters.init_p1,
-                     p2 = global_parameters.init_p2;
+    const Point<dim> p1 = global_parameters->init_p1,
+                     p2 = global_parameters->init_p2;
+
+    const std::vector<LoadCase> solved_load_cases =
+      global_parameters->get_solved_load_cases();
+    std::vector<TrilinosWrappers::MPI::Vector> solutions(
+      solved_load_cases.size());
+
+    const bool warm_start =
+      !parameters_std.direct_solver && parameters_std.linear_solver.warm_start;
 
-    for (unsigned int cycle = 0; cycle < 2; ++cycle)
+    for (unsigned int cycle = 0; cycle < parameters_std.n_cycles; ++cycle)
       {
         if (parameters_std.verbose)
           {
             pcout << "Cycle " << cycle << ':' << std::endl;
           }
 
+        parallel::distributed::
+          SolutionTransfer<dim, TrilinosWrappers::MPI::Vector>
+            solution_transfer(dof_handler);
+
         if (cycle == 0)
           {
             const std::vector<unsigned int> repetitions =
@@ -463,16 +592,56 @@ namespace Elasticity
             GridGenerator::subdivided_hyper_rectangle(
               triangulation, repetitions, p1, p2, true);
 
-            triangulation.refine_global(global_parameters.coarse_refinements);
+            triangulation.refine_global(parameters_std.n_refine);
+          }
+        else if (warm_start)
+          {
+            // The solutions of the last cycle are interpolated to the
+            // refined mesh and are the initial guesses of the solver.
+            std::vector<TrilinosWrappers::MPI::Vector> old_solutions(
+              solutions.size());
+            std::vector<const TrilinosWrappers::MPI::Vector *>
+              old_solution_ptrs;
+            for (unsigned int i = 0; i < solutions.size(); ++i)
+              {
+                old_solutions[i].reinit(locally_owned_dofs,
+                                        locally_relevant_dofs,
+                                        mpi_communicator);
+                old_solutions[i] = solutions[i];
+                old_solution_ptrs.push_back(&old_solutions[i]);
+              }
+
+            for (const auto &cell : triangulation.active_cell_iterators())
+              if (cell->is_locally_owned())
+                cell->set_refine_flag();
+
+            triangulation.prepare_coarsening_and_refinement();
+            solution_transfer.prepare_for_coarsening_and_refinement(
+              old_solution_ptrs);
+            triangulation.execute_coarsening_and_refinement();
           }
         else
           {
             // refine_grid();
-            triangulation.refine_global(global_parameters.fine_refinements);
+            triangulation.refine_global(1);
           }
 
         setup_system();
 
+        for (TrilinosWrappers::MPI::Vector &solution : solutions)
+          solution.reinit(locally_owned_dofs, mpi_communicator);
+
+        if (cycle > 0 && warm_start)
+          {
+            TimerOutput::Scope t(computing_timer, "solution transfer");
+
+            std::vector<TrilinosWrappers::MPI::Vector *> solution_ptrs;
+            for (TrilinosWrappers::MPI::Vector &solution : solutions)
+              solution_ptrs.push_back(&solution);
+
+            solution_transfer.interpolate(solution_ptrs);
+          }
+
         if (parameters_std.verbose)
           {
             pcout << "   Number of active cells:       "
@@ -481,19 +650,300 @@ namespace Elasticity
                   << std::endl;
           }
 
-        assemble_system();
+        for (unsigned int material = 0;
+             material < global_parameters->material_sweep.size();
+             ++material)
+          {
+            if (parameters_std.verbose &&
+                global_parameters->material_sweep.size() > 1)
+              {
+                pcout << "   Material " << material << ':' << std::endl;
+              }
 
-        solve();
-        {
-          TimerOutput::Scope t(computing_timer, "output");
-          output_results(cycle);
-        }
+            lame_scaling = global_parameters->material_sweep[material];
+
+            // With the affine decomposition, the system matrix of a new
+            // material is only a combination of the stored matrices.
+            const bool assemble_matrix =
+              (material == 0 || !global_parameters->affine_decomposition);
+            if (!assemble_matrix)
+              combine_system_matrix();
+
+            // The system matrix is assembled and factorized (or
+            // preconditioned) once, afterwards only the right-hand side
+            // changes.
+            for (unsigned int i = 0; i < solved_load_cases.size(); ++i)
+              {
+                if (parameters_std.verbose && solved_load_cases.size() > 1)
+                  {
+                    pcout << "   Load case " << i << ':' << std::endl;
+                  }
+
+                setup_constraints(solved_load_cases[i]);
+                assemble_system(solved_load_cases[i],
+                                /* assemble_matrix */ assemble_matrix &&
+                                  i == 0);
+
+                // Only the entries of the system matrix differ between
+                // the materials.
+                if (i == 0)
+                  initialize_solver(/* reuse_structure */ material > 0);
+
+                solve(solutions[i]);
+              }
+
+            for (unsigned int load_case = 0;
+                 load_case < global_parameters->load_cases.size();
+                 ++load_case)
+              {
+                const std::vector<double> weights =
+                  global_parameters->get_superposition_weights(load_case);
+
+                TrilinosWrappers::MPI::Vector completely_distributed_solution(
+                  locally_owned_dofs, mpi_communicator);
+                for (unsigned int i = 0; i < solutions.size(); ++i)
+                  if (weights[i] != 0.)
+                    completely_distributed_solution.add(weights[i],
+                                                        solutions[i]);
+
+                locally_relevant_solution = completely_distributed_solution;
+
+                if (write_output)
+                  {
+                    TimerOutput::Scope t(computing_timer, "output");
+                    output_results(cycle, material, load_case);
+                  }
+              }
+          }
 
         computing_timer.print_summary();
         computing_timer.reset();
         pcout << std::endl;
       }
   }
+
+
+  template <int dim>
+  void
+  ElaStd<dim>::evaluate_solution(const std::vector<Point<dim>> &points,
+                                 std::vector<Tensor<1, dim>>   &values,
+                                 std::vector<Tensor<2, dim>>   &gradients) const
+  {
+    const GridTools::Cache<dim> cache(triangulation);
+
+    std::function<bool(
+      const typename Triangulation<dim>::active_cell_iterator &)>
+      is_locally_owned = IteratorFilters::LocallyOwnedCell();
+    const std::vector<BoundingBox<dim>> local_boxes =
+      GridTools::compute_mesh_predicate_bounding_box(triangulation,
+                                                     is_locally_owned,
+                                                     /* refinement_level */ 1,
+                                                     /* allow_merge */ true,
+                                                     /* max_boxes */ 4);
+    const std::vector<std::vector<BoundingBox<dim>>> global_boxes =
+      GridTools::exchange_local_bounding_boxes(local_boxes, mpi_communicator);
+
+    const auto point_locations =
+      GridTools::distributed_compute_point_locations(cache,
+                                                     points,
+                                                     global_boxes);
+    const auto &cells            = std::get<0>(point_locations);
+    const auto &reference_points = std::get<1>(point_locations);
+    const auto &point_indices    = std::get<2>(point_locations);
+    const auto &owners           = std::get<4>(point_locations);
+
+    // Per requesting rank: the index of the point, the displacement and
+    // its gradient.
+    const unsigned int n_entries = 1 + dim + dim * dim;
+    std::map<unsigned int, std::vector<double>> evaluations;
+
+    const FEValuesExtractors::Vector displacements(0);
+    std::vector<Tensor<1, dim>>      cell_values;
+    std::vector<Tensor<2, dim>>      cell_gradients;
+
+    for (unsigned int i = 0; i < cells.size(); ++i)
+      {
+        const Quadrature<dim> quadrature(reference_points[i]);
+        FEValues<dim>         fe_values(fe,
+                                quadrature,
+                                update_values | update_gradients);
+
+        const typename DoFHandler<dim>::active_cell_iterator cell(
+          &triangulation, cells[i]->level(), cells[i]->index(), &dof_handler);
+        fe_values.reinit(cell);
+
+        cell_values.resize(quadrature.size());
+        cell_gradients.resize(quadrature.size());
+        fe_values[displacements].get_function_values(locally_relevant_solution,
+                                                     cell_values);
+        fe_values[displacements].get_function_gradients(
+          locally_relevant_solution, cell_gradients);
+
+        for (unsigned int q = 0; q < quadrature.size(); ++q)
+          {
+            std::vector<double> &evaluation = evaluations[owners[i][q]];
+            evaluation.push_back(point_indices[i][q]);
+            for (unsigned int d = 0; d < dim; ++d)
+              evaluation.push_back(cell_values[q][d]);
+            for (unsigned int d = 0; d < dim; ++d)
+              for (unsigned int e = 0; e < dim; ++e)
+                evaluation.push_back(cell_gradients[q][d][e]);
+          }
+      }
+
+    const std::map<unsigned int, std::vector<double>> received_evaluations =
+      Utilities::MPI::some_to_some(mpi_communicator, evaluations);
+
+    values.assign(points.size(), Tensor<1, dim>());
+    gradients.assign(points.size(), Tensor<2, dim>());
+    std::vector<bool> is_evaluated(points.size(), false);
+
+    for (const auto &received : received_evaluations)
+      {
+        const std::vector<double> &evaluation = received.second;
+        for (unsigned int k = 0; k < evaluation.size(); k += n_entries)
+          {
+            const unsigned int index =
+              static_cast<unsigned int>(evaluation[k]);
+
+            // Points on faces between ranks are found more than once.
+            if (is_evaluated[index])
+              continue;
+            is_evaluated[index] = true;
+
+            for (unsigned int d = 0; d < dim; ++d)
+              values[index][d] = evaluation[k + 1 + d];
+            for (unsigned int d = 0; d < dim; ++d)
+              for (unsigned int e = 0; e < dim; ++e)
+                gradients[index][d][e] = evaluation[k + 1 + dim + d * dim + e];
+          }
+      }
+
+    AssertThrow(std::all_of(is_evaluated.begin(),
+                            is_evaluated.end(),
+                            [](const bool evaluated) { return evaluated; }),
+                ExcMessage("Some points are outside of the mesh."));
+  }
+
+
+  template <int dim>
+  std::vector<MyTools::RunningStatistics>
+  ElaStd<dim>::run_ensemble(const std::vector<unsigned int> &seeds,
+                            const std::string               &sample_filename)
+  {
+    if (parameters_std.verbose)
+      {
+        pcout << "Running ensemble of " << seeds.size() << " sample(s) on "
+              << Utilities::MPI::n_mpi_processes(mpi_communicator)
+              << " MPI rank(s)..." << std::endl;
+      }
+
+    const Point<dim> p1 = global_parameters->init_p1,
+                     p2 = global_parameters->init_p2;
+
+    // This is the mesh of the last cycle of run().
+    const std::vector<unsigned int> repetitions =
+      MyTools::get_repetitions(p1, p2);
+
+    GridGenerator::subdivided_hyper_rectangle(
+      triangulation, repetitions, p1, p2, true);
+
+    triangulation.refine_global(parameters_std.n_refine +
+                                parameters_std.n_cycles - 1);
+
+    setup_system();
+
+    if (parameters_std.verbose)
+      {
+        pcout << "   Number of active cells:       "
+              << triangulation.n_global_active_cells() << std::endl
+              << "   Number of degrees of freedom: " << dof_handler.n_dofs()
+              << std::endl;
+      }
+
+    const std::vector<std::string> quantity_names =
+      get_ensemble_quantity_names();
+    std::vector<MyTools::RunningStatistics> statistics(quantity_names.size());
+
+    // Only the first rank streams the samples to the file.
+    std::ofstream sample_output;
+    if (Utilities::MPI::this_mpi_process(mpi_communicator) == 0)
+      {
+        sample_output.open(sample_filename);
+        sample_output << "seed";
+        for (const std::string &name : quantity_names)
+          sample_output << "," << name;
+        sample_output << std::endl;
+      }
+
+    const std::shared_ptr<const GlobalParameters<dim>> base_parameters =
+      global_parameters;
+    const LoadCase &load_case = global_parameters->load_cases[0];
+
+    TrilinosWrappers::MPI::Vector solution;
+
+    for (unsigned int i = 0; i < seeds.size(); ++i)
+      {
+        if (parameters_std.verbose)
+          {
+            pcout << "   Sample " << seeds[i] << ':' << std::endl;
+          }
+
+        {
+          TimerOutput::Scope t(computing_timer, "material sample");
+
+          std::shared_ptr<GlobalParameters<dim>> sample_parameters =
+            std::make_shared<GlobalParameters<dim>>(*base_parameters);
+          sample_parameters->draw_material_sample(seeds[i], mpi_communicator);
+          global_parameters = sample_parameters;
+        }
+
+        // The sparsity pattern does not depend on the material, so only
+        // the entries of the system matrix are assembled again.
+        setup_constraints(load_case);
+        assemble_system(load_case, /* assemble_matrix */ true);
+        initialize_solver(/* reuse_structure */ i > 0);
+        solve(solution);
+
+        const std::vector<double> quantities = {system_rhs * solution,
+                                                solution.linfty_norm(),
+                                                solution.l2_norm()};
+        for (unsigned int q = 0; q < quantities.size(); ++q)
+          statistics[q].add(quantities[q]);
+
+        if (sample_output.is_open())
+          {
+            sample_output << seeds[i];
+            for (const double quantity : quantities)
+              sample_output << "," << quantity;
+            sample_output << std::endl;
+          }
+      }
+
+    global_parameters = base_parameters;
+
+    computing_timer.print_summary();
+    computing_timer.reset();
+    pcout << std::endl;
+
+    return statistics;
+  }
+
+
+  template <int dim>
+  void
+  ElaStd<dim>::set_coarse_space(const ElaMs<dim> &ela_ms)
+  {
+    coarse_space = &ela_ms;
+  }
+
+
+  template <int dim>
+  std::vector<std::string>
+  ElaStd<dim>::get_ensemble_quantity_names()
+  {
+    return {"compliance", "max displacement", "displacement norm"};
+  }
 } // namespace Elasticity
 
 #endif // _INCLUDE_ELA_STD_TPP_
\ No newline at end of file
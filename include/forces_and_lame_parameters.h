@@ -7,6 +7,8 @@
 
 #include <map>
 
+#include "mytools.h"
+
 /**
  * @file forces_and_lame_parameters.h
  *
@@ -162,6 +164,11 @@ namespace Elasticity
      *
      * All of this and also the mean value of lambda must be specified in the
      * parameter file.
+     *
+     * If use_shared_memory is true, the layer values are stored once per
+     * node in an MPI shared memory window (see MyTools::SharedArray) and
+     * copies of this object only hold a view of them. In this case the
+     * constructor is collective on mpi_communicator.
      */
     LamePrm(const unsigned int &               n_x_layers,
             const unsigned int &               n_y_layers,
@@ -170,16 +177,39 @@ namespace Elasticity
             const std::vector<unsigned int> &  index_set,
             const std::map<std::string, bool> &material_structure,
             const Point<dim> &                 init_p1,
-            const Point<dim> &                 init_p2);
+            const Point<dim> &                 init_p2,
+            const MPI_Comm                     mpi_communicator,
+            const bool                         use_shared_memory);
 
     LamePrm(const double &                     fr_tmp,
             const double &                     mean,
             const std::map<std::string, bool> &material_structure,
             const Point<dim> &                 init_p1,
-            const Point<dim> &                 init_p2);
+            const Point<dim> &                 init_p2,
+            const MPI_Comm                     mpi_communicator,
+            const bool                         use_shared_memory);
 
     LamePrm(const LamePrm<dim> &other) = default;
 
+    LamePrm(LamePrm<dim> &&other) = default;
+
+    LamePrm<dim> &
+    operator=(const LamePrm<dim> &other) = default;
+
+    LamePrm<dim> &
+    operator=(LamePrm<dim> &&other) = default;
+
+    /**
+     * @brief Frees the shared memory window of the layer values if this
+     *        object created it.
+     *
+     * Collective on the communicator of the constructor, see
+     * MyTools::SharedArray::free(). Copies of this object must not be
+     * used afterwards.
+     */
+    void
+    free_shared_memory();
+
     /**
      * @brief Returns the value of lambda at the point p.
      *
@@ -238,7 +268,7 @@ namespace Elasticity
      * Contains the lambda values for each layer
      * if the material structure is layered.
      */
-    std::vector<double> values;
+    MyTools::SharedArray values;
   };
 
   // exernal template instantiations
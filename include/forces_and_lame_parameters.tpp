@@ -105,7 +105,9 @@ namespace Elasticity
                         const std::vector<unsigned int> &  index_set,
                         const std::map<std::string, bool> &material_structure,
                         const Point<dim> &                 init_p1,
-                        const Point<dim> &                 init_p2)
+                        const Point<dim> &                 init_p2,
+                        const MPI_Comm                     mpi_communicator,
+                        const bool                         use_shared_memory)
     : Function<dim>()
     , n_x_layers(n_x_layers)
     , n_y_layers(n_y_layers)
@@ -113,13 +115,14 @@ namespace Elasticity
     , material_structure(material_structure)
     , init_p1(init_p1)
     , init_p2(init_p2)
-    , values(n_x_layers * n_y_layers * n_z_layers)
   {
+    unsigned int        n_values(n_x_layers * n_y_layers * n_z_layers);
+    std::vector<double> layer_values(n_values);
+
     if (material_structure.at("horizontal layers") ||
         material_structure.at("vertical layers") ||
         material_structure.at("y-layers"))
       {
-        unsigned int        n_values(n_x_layers * n_y_layers * n_z_layers);
         double              value_step_size = 2 * mean / (n_values + 1);
         std::vector<double> values_tmp;
         for (unsigned int i = 1; i < n_values + 1; ++i)
@@ -129,7 +132,7 @@ namespace Elasticity
 
         for (unsigned int i = 0; i < n_values; ++i)
           {
-            values[i] = values_tmp[index_set[i]];
+            layer_values[i] = values_tmp[index_set[i]];
           }
 
         if (material_structure.at("horizontal layers"))
@@ -150,6 +153,9 @@ namespace Elasticity
             layer_size_inv_y = n_y_layers / depth;
           }
       }
+
+    values =
+      MyTools::SharedArray(layer_values, mpi_communicator, use_shared_memory);
   }
 
   template <int dim>
@@ -157,15 +163,24 @@ namespace Elasticity
                         const double &                     mean,
                         const std::map<std::string, bool> &material_structure,
                         const Point<dim> &                 init_p1,
-                        const Point<dim> &                 init_p2)
+                        const Point<dim> &                 init_p2,
+                        const MPI_Comm                     mpi_communicator,
+                        const bool                         use_shared_memory)
     : Function<dim>()
     , material_structure(material_structure)
     , init_p1(init_p1)
     , init_p2(init_p2)
-    , values(1)
+    , values(std::vector<double>(1, mean), mpi_communicator, use_shared_memory)
+  {
+    fr = fr_tmp / (init_p2[dim - 1] - init_p1[dim - 1]);
+  }
+
+
+  template <int dim>
+  void
+  LamePrm<dim>::free_shared_memory()
   {
-    fr        = fr_tmp / (init_p2[dim - 1] - init_p1[dim - 1]);
-    values[0] = mean;
+    values.free();
   }
 
 
@@ -0,0 +1,263 @@
+#ifndef _INCLUDE_LINEAR_SOLVER_H_
+#define _INCLUDE_LINEAR_SOLVER_H_
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/base/mpi.h>
+#include <deal.II/base/partitioner.h>
+#include <deal.II/base/smartpointer.h>
+
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/dofs/dof_tools.h>
+
+#include <deal.II/fe/fe_values_extractors.h>
+
+#include <deal.II/lac/diagonal_matrix.h>
+#include <deal.II/lac/la_parallel_vector.h>
+#include <deal.II/lac/precondition.h>
+#include <deal.II/lac/solver_cg.h>
+#include <deal.II/lac/solver_control.h>
+#include <deal.II/lac/trilinos_precondition.h>
+#include <deal.II/lac/trilinos_solver.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+#include <deal.II/lac/trilinos_vector.h>
+
+#include <Amesos.h>
+#include <Amesos_BaseSolver.h>
+#include <Epetra_LinearProblem.h>
+#include <Epetra_MultiVector.h>
+#include <Teuchos_ParameterList.hpp>
+
+#include "mytools.h"
+#include "process_parameter_file.h"
+
+// STL
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @file linear_solver.h
+ *
+ * @brief Linear solvers of ElaStd and ElaMs
+ */
+
+namespace Elasticity
+{
+  using namespace dealii;
+
+  /**
+   * @brief Single-precision copy of the locally owned rows of a
+   *        distributed Trilinos matrix.
+   *
+   * The entries are stored as float with 32 bit local column indices in
+   * CSR format, so a matrix-vector product reads about half the memory of
+   * the Trilinos matrix. Columns of other ranks are ghost entries of the
+   * vectors.
+   */
+  class SinglePrecisionMatrix
+  {
+  public:
+    using VectorType = LinearAlgebra::distributed::Vector<float>;
+
+    /**
+     * @brief Copies the entries of a matrix.
+     *
+     * @param matrix The distributed matrix
+     */
+    void
+    reinit(const TrilinosWrappers::SparseMatrix &matrix);
+
+    /**
+     * @brief Matrix-vector product.
+     *
+     * @param dst Result
+     * @param src Vector that was initialized with initialize_dof_vector()
+     */
+    void
+    vmult(VectorType &dst, const VectorType &src) const;
+
+    /**
+     * @brief Initializes a vector with the locally owned rows and the
+     *        ghost columns of this matrix.
+     *
+     * @param vector The vector
+     */
+    void
+    initialize_dof_vector(VectorType &vector) const;
+
+    /**
+     * @brief Returns the inverse of the diagonal of the matrix.
+     *
+     * @return std::shared_ptr<DiagonalMatrix<VectorType>>
+     */
+    std::shared_ptr<DiagonalMatrix<VectorType>>
+    get_inverse_diagonal() const;
+
+    /**
+     * @brief Returns the number of rows.
+     *
+     * @return types::global_dof_index
+     */
+    types::global_dof_index
+    m() const;
+
+    /**
+     * @brief Returns the number of columns.
+     *
+     * @return types::global_dof_index
+     */
+    types::global_dof_index
+    n() const;
+
+  private:
+    std::shared_ptr<const Utilities::MPI::Partitioner> partitioner;
+    std::vector<unsigned int>                          row_starts;
+    std::vector<unsigned int>                          columns;
+    std::vector<float>                                 values;
+  };
+
+
+  /**
+   * @brief Direct or preconditioned iterative solver for the global
+   *        systems of ElaStd and ElaMs.
+   *
+   * @tparam dim Space dimension
+   *
+   * The solver is chosen with ParametersSolver at run time. It is either
+   * a direct solver of Amesos or the CG method with one of the
+   * preconditioners of Trilinos:
+   *  - AMG of ML or MueLu with the rigid body modes as near null space,
+   *  - Chebyshev,
+   *  - ILU,
+   *  - block Jacobi, where each block couples the displacement components
+   *    at one support point,
+   *  - SSOR.
+   *
+   * initialize() factorizes the matrix or sets up the preconditioner once,
+   * solve() can then be called for many right-hand sides. If only the
+   * entries of the matrix change, initialize() can keep the structural
+   * part of the setup:
+   *  - the symbolic factorization of the direct solver,
+   *  - the aggregates of the ML preconditioner.
+   * The other preconditioners are set up from scratch.
+   *
+   * With ParametersSolver::mixed_precision, the CG method runs on a
+   * SinglePrecisionMatrix with a float Chebyshev-Jacobi preconditioner
+   * inside an iterative refinement loop that computes the residuals in
+   * double precision. The Trilinos preconditioners are not used then.
+   */
+  template <int dim>
+  class LinearSolver
+  {
+  public:
+    /**
+     * @brief Construct a new LinearSolver object.
+     *
+     * @param parameters_solver Parameters of the solver
+     */
+    LinearSolver(const ParametersSolver &parameters_solver);
+
+    /**
+     * @brief Factorizes the matrix or sets up the preconditioner.
+     *
+     * @param system_matrix The matrix. It must not be destroyed before
+     *                      the last call of solve().
+     * @param dof_handler DoFHandler of the system
+     * @param reuse_structure If true, the matrix is the same object with
+     *                        the same sparsity pattern as in the last call
+     *                        and only its entries have changed. Otherwise,
+     *                        the solver is set up from scratch.
+     */
+    void
+    initialize(const TrilinosWrappers::SparseMatrix &system_matrix,
+               const DoFHandler<dim> &               dof_handler,
+               const bool                            reuse_structure = false);
+
+    /**
+     * @brief Solves the system.
+     *
+     * @param solution Vector for the solution with the locally owned dofs
+     * @param system_rhs The right-hand side
+     * @param relative_tolerance The iterative solvers stop if the residual
+     *                           is below this times the norm of system_rhs
+     * @param reduction The iterative solvers also stop if the residual is
+     *                  reduced by this factor
+     * @return unsigned int Number of CG iterations, 0 for direct solvers
+     */
+    unsigned int
+    solve(TrilinosWrappers::MPI::Vector &      solution,
+          const TrilinosWrappers::MPI::Vector &system_rhs,
+          const double                         relative_tolerance = 1e-8,
+          const double                         reduction          = 0.);
+
+    /**
+     * @brief Returns a description of the solver for output and timers.
+     *
+     * @return std::string
+     */
+    std::string
+    get_name() const;
+
+    /**
+     * @brief Checks if the last call of initialize() reused the structure.
+     *
+     * @return true if only the numerical part of the setup was redone
+     */
+    bool
+    reused_structure() const;
+
+  private:
+    /**
+     * @brief Sets up the AMG preconditioner.
+     *
+     * @param dof_handler DoFHandler of the system
+     */
+    void
+    initialize_amg(const DoFHandler<dim> &dof_handler);
+
+    /**
+     * @brief Returns an upper bound of the largest eigenvalue of the
+     *        Jacobi-scaled #system_matrix for the Chebyshev preconditioner.
+     *
+     * @return double Maximum over all rows of the Gershgorin bound
+     */
+    double
+    estimate_max_eigenvalue() const;
+
+    /**
+     * @brief Solves the system with mixed-precision iterative refinement.
+     *
+     * @param solution Initial guess and solution
+     * @param system_rhs The right-hand side
+     * @param relative_tolerance As in solve()
+     * @param reduction As in solve()
+     * @return unsigned int Number of CG iterations in single precision
+     */
+    unsigned int
+    solve_mixed_precision(
+      TrilinosWrappers::MPI::Vector &      solution,
+      const TrilinosWrappers::MPI::Vector &system_rhs,
+      const double                         relative_tolerance,
+      const double                         reduction);
+
+    const ParametersSolver                              parameters_solver;
+    SmartPointer<const TrilinosWrappers::SparseMatrix>  system_matrix;
+    std::unique_ptr<Epetra_LinearProblem>               linear_problem;
+    std::unique_ptr<Amesos_BaseSolver>                  direct_solver;
+    std::unique_ptr<TrilinosWrappers::PreconditionBase> preconditioner;
+    std::vector<double>                                 rigid_body_modes;
+    /**< Near null space of the ML preconditioner, see
+     *   MyTools::get_rigid_body_modes(). */
+    bool                                                structure_reused;
+    SinglePrecisionMatrix                               float_matrix;
+    PreconditionChebyshev<SinglePrecisionMatrix,
+                          SinglePrecisionMatrix::VectorType>
+      float_preconditioner;
+  };
+
+  // exernal template instantiations
+  extern template class LinearSolver<2>;
+  extern template class LinearSolver<3>;
+} // namespace Elasticity
+
+#endif // _INCLUDE_LINEAR_SOLVER_H_
@@ -0,0 +1,387 @@
+#ifndef _INCLUDE_LINEAR_SOLVER_TPP_
+#define _INCLUDE_LINEAR_SOLVER_TPP_
+
+#include "linear_solver.h"
+
+namespace Elasticity
+{
+  using namespace dealii;
+
+  /****************************************************************************/
+  /* Linear solvers of ElaStd and ElaMs */
+
+  template <int dim>
+  LinearSolver<dim>::LinearSolver(const ParametersSolver &parameters_solver)
+    : parameters_solver(parameters_solver)
+    , structure_reused(false)
+  {}
+
+
+  template <int dim>
+  void
+  LinearSolver<dim>::initialize(
+    const TrilinosWrappers::SparseMatrix &system_matrix,
+    const DoFHandler<dim>                &dof_handler,
+    const bool                            reuse_structure)
+  {
+    // The structure can only be reused if the solver was set up for this
+    // matrix before.
+    structure_reused = reuse_structure &&
+                       (this->system_matrix == &system_matrix) &&
+                       (direct_solver || preconditioner);
+
+    this->system_matrix = &system_matrix;
+
+    if (parameters_solver.direct_solver)
+      {
+        // Amesos is used directly since TrilinosWrappers::SolverDirect
+        // always repeats the symbolic factorization.
+        if (!structure_reused)
+          {
+            linear_problem = std::make_unique<Epetra_LinearProblem>();
+            linear_problem->SetOperator(const_cast<Epetra_CrsMatrix *>(
+              &system_matrix.trilinos_matrix()));
+
+            Amesos factory;
+            direct_solver.reset(
+              factory.Create(parameters_solver.direct_solver_type.c_str(),
+                             *linear_problem));
+            AssertThrow(direct_solver != nullptr,
+                        ExcMessage("The direct solver " +
+                                   parameters_solver.direct_solver_type +
+                                   " is not available in Amesos."));
+
+            AssertThrow(direct_solver->SymbolicFactorization() == 0,
+                        ExcMessage("The symbolic factorization failed."));
+          }
+
+        // The factorization is computed once here and reused for all
+        // right-hand sides.
+        AssertThrow(direct_solver->NumericFactorization() == 0,
+                    ExcMessage("The numeric factorization failed."));
+
+        return;
+      }
+
+    if (parameters_solver.mixed_precision)
+      {
+        float_matrix.reinit(system_matrix);
+
+        typename PreconditionChebyshev<
+          SinglePrecisionMatrix,
+          SinglePrecisionMatrix::VectorType>::AdditionalData data;
+        data.degree              = parameters_solver.chebyshev_degree;
+        data.smoothing_range     = 30.;
+        data.eig_cg_n_iterations = 20;
+        data.preconditioner      = float_matrix.get_inverse_diagonal();
+
+        float_preconditioner.initialize(float_matrix, data);
+
+        return;
+      }
+
+    if (parameters_solver.preconditioner == "AMG")
+      {
+        if (structure_reused && parameters_solver.amg_package == "ML")
+          {
+            static_cast<TrilinosWrappers::PreconditionAMG &>(*preconditioner)
+              .reinit();
+            return;
+          }
+
+        initialize_amg(dof_handler);
+      }
+    else if (parameters_solver.preconditioner == "Chebyshev")
+      {
+        TrilinosWrappers::PreconditionChebyshev::AdditionalData data(
+          parameters_solver.chebyshev_degree,
+          /* max_eigenvalue */ estimate_max_eigenvalue());
+
+        auto chebyshev =
+          std::make_unique<TrilinosWrappers::PreconditionChebyshev>();
+        chebyshev->initialize(system_matrix, data);
+        preconditioner = std::move(chebyshev);
+      }
+    else if (parameters_solver.preconditioner == "ILU")
+      {
+        TrilinosWrappers::PreconditionILU::AdditionalData data(
+          parameters_solver.ilu_fill);
+
+        auto ilu = std::make_unique<TrilinosWrappers::PreconditionILU>();
+        ilu->initialize(system_matrix, data);
+        preconditioner = std::move(ilu);
+      }
+    else if (parameters_solver.preconditioner == "block Jacobi")
+      {
+        // The dofs of a support point are numbered consecutively, so
+        // blocks of dim rows couple the displacement components at one
+        // support point.
+        TrilinosWrappers::PreconditionBlockJacobi::AdditionalData data(
+          /* block_size */ dim,
+          /* block_creation_type */ "linear",
+          parameters_solver.relaxation);
+
+        auto block_jacobi =
+          std::make_unique<TrilinosWrappers::PreconditionBlockJacobi>();
+        block_jacobi->initialize(system_matrix, data);
+        preconditioner = std::move(block_jacobi);
+      }
+    else if (parameters_solver.preconditioner == "SSOR")
+      {
+        TrilinosWrappers::PreconditionSSOR::AdditionalData data(
+          parameters_solver.relaxation);
+
+        auto ssor = std::make_unique<TrilinosWrappers::PreconditionSSOR>();
+        ssor->initialize(system_matrix, data);
+        preconditioner = std::move(ssor);
+      }
+    else
+      {
+        AssertThrow(false, ExcNotImplemented());
+      }
+  }
+
+
+  template <int dim>
+  void
+  LinearSolver<dim>::initialize_amg(const DoFHandler<dim> &dof_handler)
+  {
+    std::vector<std::vector<bool>>   constant_modes;
+    const FEValuesExtractors::Vector displacement_components(0);
+    DoFTools::extract_constant_modes(dof_handler,
+                                     dof_handler.get_fe().component_mask(
+                                       displacement_components),
+                                     constant_modes);
+
+    if (parameters_solver.amg_package == "MueLu")
+      {
+#ifdef DEAL_II_TRILINOS_WITH_MUELU
+        TrilinosWrappers::PreconditionAMGMueLu::AdditionalData data;
+        data.constant_modes        = constant_modes;
+        data.elliptic              = true;
+        data.smoother_sweeps       = parameters_solver.smoother_sweeps;
+        data.smoother_type         = parameters_solver.smoother_type.c_str();
+        data.aggregation_threshold = parameters_solver.aggregation_threshold;
+
+        auto amg = std::make_unique<TrilinosWrappers::PreconditionAMGMueLu>();
+        amg->initialize(*system_matrix, data);
+        preconditioner = std::move(amg);
+#else
+        AssertThrow(false,
+                    ExcMessage("deal.II was configured without MueLu."));
+#endif
+        return;
+      }
+
+    TrilinosWrappers::PreconditionAMG::AdditionalData data;
+    data.constant_modes        = constant_modes;
+    data.elliptic              = true;
+    data.higher_order_elements = false;
+    data.smoother_sweeps       = parameters_solver.smoother_sweeps;
+    data.smoother_type         = parameters_solver.smoother_type.c_str();
+    data.aggregation_threshold = parameters_solver.aggregation_threshold;
+
+    auto amg = std::make_unique<TrilinosWrappers::PreconditionAMG>();
+
+    if (parameters_solver.rigid_body_modes)
+      {
+        // The near null space of elasticity contains the rotations besides
+        // the translations. AdditionalData::constant_modes can only
+        // describe the translations, so the null space is set directly in
+        // the parameter list of ML.
+        rigid_body_modes = MyTools::get_rigid_body_modes(dof_handler);
+
+        Teuchos::ParameterList              parameter_list;
+        std::unique_ptr<Epetra_MultiVector> distributed_constant_modes;
+        data.set_parameters(parameter_list,
+                            distributed_constant_modes,
+                            system_matrix->trilinos_matrix());
+        parameter_list.set("null space: type", "pre-computed");
+        parameter_list.set("null space: dimension",
+                           static_cast<int>(dim * (dim + 1) / 2));
+        parameter_list.set("null space: vectors", rigid_body_modes.data());
+
+        amg->initialize(*system_matrix, parameter_list);
+      }
+    else
+      {
+        amg->initialize(*system_matrix, data);
+      }
+
+    preconditioner = std::move(amg);
+  }
+
+
+  template <int dim>
+  double
+  LinearSolver<dim>::estimate_max_eigenvalue() const
+  {
+    double max_eigenvalue = 0;
+
+    for (const types::global_dof_index row :
+         system_matrix->locally_owned_range_indices())
+      {
+        double diagonal = 0, row_sum = 0;
+        for (auto entry = system_matrix->begin(row);
+             entry != system_matrix->end(row);
+             ++entry)
+          {
+            row_sum += std::abs(entry->value());
+            if (entry->column() == row)
+              diagonal = entry->value();
+          }
+
+        if (diagonal > 0)
+          max_eigenvalue = std::max(max_eigenvalue, row_sum / diagonal);
+      }
+
+    return Utilities::MPI::max(max_eigenvalue,
+                               system_matrix->get_mpi_communicator());
+  }
+
+
+  template <int dim>
+  unsigned int
+  LinearSolver<dim>::solve(
+    TrilinosWrappers::MPI::Vector       &solution,
+    const TrilinosWrappers::MPI::Vector &system_rhs,
+    const double                         relative_tolerance,
+    const double                         reduction)
+  {
+    if (parameters_solver.direct_solver)
+      {
+        linear_problem->SetLHS(&solution.trilinos_vector());
+        linear_problem->SetRHS(const_cast<Epetra_MultiVector *>(
+          &system_rhs.trilinos_vector()));
+
+        AssertThrow(direct_solver->Solve() == 0,
+                    ExcMessage("The direct solver failed."));
+
+        return 0;
+      }
+
+    if (parameters_solver.mixed_precision)
+      return solve_mixed_precision(solution,
+                                   system_rhs,
+                                   relative_tolerance,
+                                   reduction);
+
+    const double solver_tolerance = relative_tolerance * system_rhs.l2_norm();
+    ReductionControl solver_control(
+      /* n_max_iter */ system_rhs.size(),
+      solver_tolerance,
+      reduction,
+      /* log_history */ true,
+      /* log_result */ true);
+
+    TrilinosWrappers::SolverCG solver(solver_control);
+
+    try
+      {
+        solver.solve(*system_matrix, solution, system_rhs, *preconditioner);
+      }
+    catch (std::exception &e)
+      {
+        Assert(false, ExcMessage(e.what()));
+      }
+
+    return solver_control.last_step();
+  }
+
+
+  template <int dim>
+  unsigned int
+  LinearSolver<dim>::solve_mixed_precision(
+    TrilinosWrappers::MPI::Vector       &solution,
+    const TrilinosWrappers::MPI::Vector &system_rhs,
+    const double                         relative_tolerance,
+    const double                         reduction)
+  {
+    double tolerance = relative_tolerance * system_rhs.l2_norm();
+
+    // Each refinement step reduces the residual by a factor that single
+    // precision can still resolve.
+    const double       inner_reduction      = 1e-4;
+    const unsigned int max_refinement_steps = 20;
+
+    TrilinosWrappers::MPI::Vector     residual(system_rhs);
+    SinglePrecisionMatrix::VectorType float_residual, float_correction;
+    float_matrix.initialize_dof_vector(float_residual);
+    float_matrix.initialize_dof_vector(float_correction);
+
+    unsigned int n_iterations = 0;
+    for (unsigned int step = 0; step < max_refinement_steps; ++step)
+      {
+        // residual in double precision
+        system_matrix->vmult(residual, solution);
+        residual.sadd(-1., 1., system_rhs);
+
+        const double residual_norm = residual.l2_norm();
+        if (step == 0)
+          tolerance = std::max(tolerance, reduction * residual_norm);
+        if (residual_norm <= tolerance)
+          return n_iterations;
+
+        // correction in single precision
+        std::copy(residual.begin(), residual.end(), float_residual.begin());
+        float_correction = 0;
+
+        SolverControl solver_control(
+          /* n_max_iter */ system_rhs.size(),
+          std::max(inner_reduction * residual_norm, 0.5 * tolerance),
+          /* log_history */ false,
+          /* log_result */ false);
+
+        SolverCG<SinglePrecisionMatrix::VectorType> solver(solver_control);
+
+        try
+          {
+            solver.solve(float_matrix,
+                         float_correction,
+                         float_residual,
+                         float_preconditioner);
+          }
+        catch (std::exception &e)
+          {
+            Assert(false, ExcMessage(e.what()));
+          }
+
+        n_iterations += solver_control.last_step();
+
+        TrilinosWrappers::MPI::Vector::iterator x = solution.begin();
+        for (unsigned int i = 0; i < float_correction.local_size(); ++i)
+          x[i] += float_correction.local_element(i);
+      }
+
+    AssertThrow(false,
+                ExcMessage("The mixed-precision iterative refinement did not "
+                           "converge."));
+
+    return n_iterations;
+  }
+
+
+  template <int dim>
+  std::string
+  LinearSolver<dim>::get_name() const
+  {
+    if (parameters_solver.direct_solver)
+      return "direct solver (" + parameters_solver.direct_solver_type + ")";
+    else if (parameters_solver.mixed_precision)
+      return "mixed-precision CG with Chebyshev";
+    else if (parameters_solver.preconditioner == "AMG")
+      return "CG with AMG (" + parameters_solver.amg_package + ")";
+    else
+      return "CG with " + parameters_solver.preconditioner;
+  }
+
+
+  template <int dim>
+  bool
+  LinearSolver<dim>::reused_structure() const
+  {
+    return structure_reused;
+  }
+} // namespace Elasticity
+
+#endif // _INCLUDE_LINEAR_SOLVER_TPP_
@@ -2,19 +2,25 @@
 #define _INCLUDE_MY_TOOLS_H_
 
 #include <deal.II/base/function.h>
+#include <deal.II/base/mpi.h>
 #include <deal.II/base/point.h>
 #include <deal.II/base/tensor.h>
 
 #include <deal.II/distributed/tria.h>
 
+#include <deal.II/dofs/dof_handler.h>
+
 #include <deal.II/physics/transformations.h>
 
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <list>
+#include <memory>
 #include <stdexcept>
 #include <string>
-
-#include "process_parameter_file.h"
+#include <utility>
+#include <vector>
 
 /**
  * @namespace MyTools
@@ -69,6 +75,92 @@ namespace MyTools
   get_repetitions(const Point<dim> &p1, const Point<dim> &p2);
 
 
+  /**
+   * @brief Get the index of a vertex of a uniformly refined box
+   *
+   * @tparam dim Space dimension
+   * @param p Vertex of the refined box
+   * @param p1 Lower left corner of the box
+   * @param p2 Upper right corner of the box
+   * @param n_intervals Number of intervals in each direction
+   * @return unsigned int
+   *
+   * The vertices of the box are numbered lexicographically with the
+   * x-direction running fastest. The index only depends on the position
+   * of p, so it can be compared between different meshes of the box.
+   */
+  template <int dim>
+  unsigned int
+  get_lattice_index(const Point<dim> & p,
+                    const Point<dim> & p1,
+                    const Point<dim> & p2,
+                    const unsigned int n_intervals);
+
+
+  /**
+   * @brief Get the index of a vertex in a box refined with a different
+   *        number of intervals in each direction
+   *
+   * @tparam dim Space dimension
+   * @param p Vertex of the refined box
+   * @param p1 Lower left corner of the box
+   * @param p2 Upper right corner of the box
+   * @param n_intervals Number of intervals in each direction
+   * @return unsigned int
+   *
+   * The numbering is that of the overload with the same number of
+   * intervals in each direction.
+   */
+  template <int dim>
+  unsigned int
+  get_lattice_index(const Point<dim> &               p,
+                    const Point<dim> &               p1,
+                    const Point<dim> &               p2,
+                    const std::vector<unsigned int> &n_intervals);
+
+
+  /**
+   * @brief Get the smallest and largest values of functions in a box
+   *
+   * @tparam dim Space dimension
+   * @param functions Scalar functions
+   * @param p1 Lower left corner of the box
+   * @param p2 Upper right corner of the box
+   * @param n_intervals Number of intervals of the lattice in each direction
+   * @return std::vector<std::pair<double, double>> The minimum and the
+   *         maximum of each function
+   *
+   * The functions are sampled at the vertices of a lattice in the box, so
+   * features much thinner than the box, like thin material layers, are
+   * seen as well.
+   */
+  template <int dim>
+  std::vector<std::pair<double, double>>
+  get_min_max_on_lattice(const std::vector<const Function<dim> *> &functions,
+                         const Point<dim> &                        p1,
+                         const Point<dim> &                        p2,
+                         const unsigned int                        n_intervals);
+
+
+  /**
+   * @brief Get the rigid body modes of a displacement field
+   *
+   * @tparam dim Space dimension
+   * @param dof_handler DoFHandler of a vector-valued Lagrange element with
+   *                    dim components
+   * @return std::vector<double> The dim translations followed by the
+   *         dim * (dim - 1) / 2 rotations, each with one entry per locally
+   *         owned dof in the order of DoFHandler::locally_owned_dofs()
+   *
+   * The modes are evaluated at the support points of the dofs. The layout
+   * is that of the "null space: vectors" of ML, so the returned vector can
+   * be handed to the AMG preconditioner of Trilinos as near null space.
+   */
+  template <int dim>
+  std::vector<double>
+  get_rigid_body_modes(const DoFHandler<dim> &dof_handler);
+
+
   /*!
    * @brief Creates a directory with a name from a given string
    *
@@ -78,6 +170,239 @@ namespace MyTools
   create_data_directory(const char *dir_name);
 
 
+  /**
+   * @brief Read-only array of doubles that can be stored once per node.
+   *
+   * Copies of a SharedArray are lightweight views of the same memory.
+   *
+   * If the array is created with shared memory, the first rank of each
+   * node allocates an MPI-3 shared memory window, copies the values into
+   * it and all other ranks of the node read from this window. Otherwise
+   * the values are stored in ordinary rank-local memory.
+   *
+   * The object that created the window owns it, copies are views. Since
+   * freeing the window is collective on the node, it is not done by a
+   * destructor but by the owner with free() at a point that all ranks of
+   * the communicator reach together. Views must not be used afterwards.
+   */
+  class SharedArray
+  {
+  public:
+    /**
+     * @brief Construct a new (empty) SharedArray object.
+     */
+    SharedArray();
+
+    /**
+     * @brief Construct a new SharedArray object.
+     *
+     * @param values Values to be stored. They must be the same on all
+     *               ranks of the communicator.
+     * @param mpi_communicator The MPI communicator
+     * @param use_shared_memory If true, the values are stored in a
+     *                          shared memory window per node.
+     *
+     * This constructor is collective on mpi_communicator if
+     * use_shared_memory is true.
+     */
+    SharedArray(const std::vector<double> &values,
+                const MPI_Comm             mpi_communicator,
+                const bool                 use_shared_memory);
+
+    /**
+     * @brief Copy constructor. Only the view is copied, the copy does not
+     *        own the window.
+     *
+     * @param other Other SharedArray
+     */
+    SharedArray(const SharedArray &other);
+
+    /**
+     * @brief Move constructor. The ownership of the window is moved.
+     *
+     * @param other Other SharedArray
+     */
+    SharedArray(SharedArray &&other) noexcept;
+
+    /**
+     * @brief Copy assignment. Only the view is copied.
+     *
+     * @param other Other SharedArray
+     * @return SharedArray&
+     *
+     * This object must not own a window, see free().
+     */
+    SharedArray &
+    operator=(const SharedArray &other);
+
+    /**
+     * @brief Move assignment. The ownership of the window is moved.
+     *
+     * @param other Other SharedArray
+     * @return SharedArray&
+     *
+     * This object must not own a window, see free().
+     */
+    SharedArray &
+    operator=(SharedArray &&other);
+
+    /**
+     * @brief Frees the shared memory window if this object owns it.
+     *
+     * This function is collective on the node if this object owns a
+     * window, which is the case on all ranks or on none. Otherwise it does
+     * nothing.
+     */
+    void
+    free();
+
+    /**
+     * @brief Access an entry.
+     *
+     * @param i Index of the entry
+     * @return const double&
+     */
+    const double &
+    operator[](const std::size_t i) const;
+
+    /**
+     * @brief Returns the number of entries.
+     *
+     * @return std::size_t
+     */
+    std::size_t
+    size() const;
+
+    /**
+     * @brief Returns true if the entries live in a shared memory window.
+     *
+     * @return bool
+     */
+    bool
+    is_shared() const;
+
+  private:
+    /**
+     * Pointer to the first entry. The deleter releases the memory or the
+     * shared memory window.
+     */
+    std::shared_ptr<const double> data;
+
+    /**
+     * Number of entries
+     */
+    std::size_t n_values;
+
+    /**
+     * True if #data points into a shared memory window.
+     */
+    bool shared;
+
+    /**
+     * True if this object created the window and has to free() it.
+     */
+    bool owner;
+
+    /**
+     * The shared memory window, only set in the #owner.
+     */
+    MPI_Win window;
+
+    /**
+     * Communicator of the ranks on this node, only set in the #owner.
+     */
+    MPI_Comm node_communicator;
+  };
+
+
+  /**
+   * @brief Running mean and variance of a stream of values.
+   *
+   * The values are not stored. The mean and the sum of squared deviations
+   * are updated with Welford's algorithm and two statistics can be merged
+   * with the formula of Chan et al.
+   */
+  class RunningStatistics
+  {
+  public:
+    /**
+     * @brief Construct a new (empty) RunningStatistics object.
+     */
+    RunningStatistics();
+
+    /**
+     * @brief Construct a new RunningStatistics object from its state.
+     *
+     * @param state State as returned by get_state()
+     */
+    RunningStatistics(const std::vector<double> &state);
+
+    /**
+     * @brief Adds a value.
+     *
+     * @param value Value
+     */
+    void
+    add(const double value);
+
+    /**
+     * @brief Adds all values of another RunningStatistics object.
+     *
+     * @param other Other RunningStatistics
+     */
+    void
+    merge(const RunningStatistics &other);
+
+    /**
+     * @brief Returns the number of values.
+     *
+     * @return unsigned long int
+     */
+    unsigned long int
+    n_values() const;
+
+    /**
+     * @brief Returns the mean of the values.
+     *
+     * @return double
+     */
+    double
+    mean() const;
+
+    /**
+     * @brief Returns the (unbiased) sample variance of the values.
+     *
+     * @return double
+     */
+    double
+    variance() const;
+
+    /**
+     * @brief Returns the state, e.g. to send it to another rank.
+     *
+     * @return std::vector<double>
+     */
+    std::vector<double>
+    get_state() const;
+
+  private:
+    /**
+     * Number of values
+     */
+    unsigned long int n;
+
+    /**
+     * Mean of the values
+     */
+    double mean_value;
+
+    /**
+     * Sum of the squared deviations from #mean_value
+     */
+    double sum_of_squares;
+  };
+
+
   template <int dim>
   class Rotation : public Function<dim>
   {
@@ -1,10 +1,16 @@
 #ifndef _INCLUDE_MY_TOOLS_TPP_
 #define _INCLUDE_MY_TOOLS_TPP_
 
+#include <deal.II/base/quadrature.h>
+#include <deal.II/base/quadrature_lib.h>
 #include <deal.II/base/symmetric_tensor.h>
 
+#include <deal.II/fe/fe_values.h>
+
 #include <math.h>
 
+#include <limits>
+
 #include "mytools.h"
 
 namespace MyTools
@@ -68,6 +74,141 @@ namespace MyTools
   }
 
 
+  template <int dim>
+  unsigned int
+  get_lattice_index(const Point<dim>  &p,
+                    const Point<dim>  &p1,
+                    const Point<dim>  &p2,
+                    const unsigned int n_intervals)
+  {
+    unsigned int index = 0;
+    for (int d = dim - 1; d >= 0; --d)
+      {
+        const unsigned int lattice_coordinate = static_cast<unsigned int>(
+          std::round((p[d] - p1[d]) / (p2[d] - p1[d]) * n_intervals));
+
+        Assert(lattice_coordinate <= n_intervals,
+               ExcIndexRange(lattice_coordinate, 0, n_intervals + 1));
+
+        index = index * (n_intervals + 1) + lattice_coordinate;
+      }
+
+    return index;
+  }
+
+
+  template <int dim>
+  unsigned int
+  get_lattice_index(const Point<dim>                &p,
+                    const Point<dim>                &p1,
+                    const Point<dim>                &p2,
+                    const std::vector<unsigned int> &n_intervals)
+  {
+    AssertDimension(n_intervals.size(), dim);
+
+    unsigned int index = 0;
+    for (int d = dim - 1; d >= 0; --d)
+      {
+        const unsigned int lattice_coordinate = static_cast<unsigned int>(
+          std::round((p[d] - p1[d]) / (p2[d] - p1[d]) * n_intervals[d]));
+
+        Assert(lattice_coordinate <= n_intervals[d],
+               ExcIndexRange(lattice_coordinate, 0, n_intervals[d] + 1));
+
+        index = index * (n_intervals[d] + 1) + lattice_coordinate;
+      }
+
+    return index;
+  }
+
+
+  template <int dim>
+  std::vector<std::pair<double, double>>
+  get_min_max_on_lattice(const std::vector<const Function<dim> *> &functions,
+                         const Point<dim>                         &p1,
+                         const Point<dim>                         &p2,
+                         const unsigned int                       n_intervals)
+  {
+    const QIterated<dim> lattice(QTrapez<1>(), n_intervals);
+
+    std::vector<std::pair<double, double>> min_max(
+      functions.size(),
+      std::make_pair(std::numeric_limits<double>::max(),
+                     std::numeric_limits<double>::lowest()));
+    for (const Point<dim> &unit_point : lattice.get_points())
+      {
+        Point<dim> point = p1;
+        for (unsigned int d = 0; d < dim; ++d)
+          point[d] += unit_point[d] * (p2[d] - p1[d]);
+
+        for (unsigned int i = 0; i < functions.size(); ++i)
+          {
+            const double value = functions[i]->value(point);
+            min_max[i].first   = std::min(min_max[i].first, value);
+            min_max[i].second  = std::max(min_max[i].second, value);
+          }
+      }
+
+    return min_max;
+  }
+
+
+  template <int dim>
+  std::vector<double>
+  get_rigid_body_modes(const DoFHandler<dim> &dof_handler)
+  {
+    const FiniteElement<dim> &fe = dof_handler.get_fe();
+    const IndexSet &locally_owned_dofs = dof_handler.locally_owned_dofs();
+    const unsigned int n_owned_dofs    = locally_owned_dofs.n_elements();
+    const unsigned int n_modes         = dim * (dim + 1) / 2;
+
+    AssertDimension(fe.n_components(), dim);
+
+    std::vector<double> modes(n_modes * n_owned_dofs, 0.);
+
+    const Quadrature<dim> support_quadrature(fe.get_unit_support_points());
+    FEValues<dim>         fe_values(fe,
+                            support_quadrature,
+                            update_quadrature_points);
+
+    std::vector<types::global_dof_index> local_dof_indices(fe.dofs_per_cell);
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+        {
+          fe_values.reinit(cell);
+          cell->get_dof_indices(local_dof_indices);
+
+          for (unsigned int k = 0; k < fe.dofs_per_cell; ++k)
+            {
+              if (!locally_owned_dofs.is_element(local_dof_indices[k]))
+                continue;
+
+              const unsigned int i =
+                locally_owned_dofs.index_within_set(local_dof_indices[k]);
+              const unsigned int component =
+                fe.system_to_component_index(k).first;
+              const Point<dim> &x = fe_values.quadrature_point(k);
+
+              // translations
+              modes[component * n_owned_dofs + i] = 1.;
+
+              // rotations in the plane of the directions a and b
+              unsigned int mode = dim;
+              for (unsigned int a = 0; a < dim; ++a)
+                for (unsigned int b = a + 1; b < dim; ++b, ++mode)
+                  {
+                    if (component == a)
+                      modes[mode * n_owned_dofs + i] = -x[b];
+                    else if (component == b)
+                      modes[mode * n_owned_dofs + i] = x[a];
+                  }
+            }
+        }
+
+    return modes;
+  }
+
+
   template <int dim>
   Rotation<dim>::Rotation(const Point<dim> init_p1,
                           const Point<dim> init_p2,
@@ -5,6 +5,8 @@
 
 #include <deal.II/numerics/data_postprocessor.h>
 
+#include <memory>
+
 #include "process_parameter_file.h"
 
 /**
@@ -127,16 +129,22 @@ namespace Elasticity
      *
      * @param basis_index Index of the basis function
      * @param global_parameters Parameters that many classes need
+     * @param lame_scaling Scaling of the Lamé parameters
      */
-    StressPostprocessor(unsigned int                 basis_index,
-                        const GlobalParameters<dim> &global_parameters);
+    StressPostprocessor(
+      unsigned int                                        basis_index,
+      const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+      const LameScaling &lame_scaling = LameScaling{1., 1.});
 
     /**
      * @brief Construct a new Stress Postprocessor object
      *
      * @param global_parameters Parameters that many classes need
+     * @param lame_scaling Scaling of the Lamé parameters
      */
-    StressPostprocessor(const GlobalParameters<dim> &global_parameters);
+    StressPostprocessor(
+      const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+      const LameScaling &lame_scaling = LameScaling{1., 1.});
 
     /**
      * @brief Copy constructor for StressPostprocessor objects
@@ -191,8 +199,17 @@ namespace Elasticity
      * String that contains the index of the local shape
      * shape function in ElaBasis.
      */
-    std::string           basis_str;
-    GlobalParameters<dim> parameters;
+    std::string basis_str;
+
+    /**
+     * Shared handle to the parameters that many classes need.
+     */
+    std::shared_ptr<const GlobalParameters<dim>> parameters;
+
+    /**
+     * Scaling of the Lamé parameters of #parameters
+     */
+    LameScaling lame_scaling;
   };
 } // namespace Elasticity
 
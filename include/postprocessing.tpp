@@ -118,23 +118,28 @@ namespace Elasticity
   template <int dim>
   StressPostprocessor<dim>::StressPostprocessor()
     : basis_str("")
+    , lame_scaling{1., 1.}
   {}
 
 
   template <int dim>
   StressPostprocessor<dim>::StressPostprocessor(
-    unsigned int                 basis_index,
-    const GlobalParameters<dim> &global_parameters)
+    unsigned int                                        basis_index,
+    const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+    const LameScaling                                  &lame_scaling)
     : basis_str("_" + Utilities::int_to_string(basis_index, 2))
     , parameters(global_parameters)
+    , lame_scaling(lame_scaling)
   {}
 
 
   template <int dim>
   StressPostprocessor<dim>::StressPostprocessor(
-    const GlobalParameters<dim> &global_parameters)
+    const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+    const LameScaling                                  &lame_scaling)
     : basis_str("")
     , parameters(global_parameters)
+    , lame_scaling(lame_scaling)
   {}
 
 
@@ -149,8 +154,13 @@ namespace Elasticity
                     computed_quantities.size());
     std::vector<double> mu_values(input_data.evaluation_points.size()),
       lambda_values(input_data.evaluation_points.size());
-    parameters.mu.value_list(input_data.evaluation_points, mu_values);
-    parameters.lambda.value_list(input_data.evaluation_points, lambda_values);
+    parameters->mu.value_list(input_data.evaluation_points, mu_values);
+    parameters->lambda.value_list(input_data.evaluation_points, lambda_values);
+    for (unsigned int p = 0; p < input_data.evaluation_points.size(); ++p)
+      {
+        lambda_values[p] *= lame_scaling.lambda;
+        mu_values[p] *= lame_scaling.mu;
+      }
     for (unsigned int p = 0; p < input_data.solution_gradients.size(); ++p)
       {
         AssertDimension(computed_quantities[p].size(),
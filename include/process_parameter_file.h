@@ -1,6 +1,7 @@
 #ifndef _INCLUDE_PARAMETER_FILE_H_
 #define _INCLUDE_PARAMETER_FILE_H_
 
+#include <deal.II/base/mpi.h>
 #include <deal.II/base/parameter_handler.h>
 #include <deal.II/base/point.h>
 
@@ -11,7 +12,9 @@
 #include <iostream>
 #include <numeric>
 #include <random>
+#include <sstream>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include "forces_and_lame_parameters.h"
@@ -29,6 +32,93 @@ namespace Elasticity
 {
   using namespace dealii;
 
+  /**
+   * @brief Content of a parameter file that is shared by all ranks.
+   *
+   * Only the root rank of the communicator opens the parameter file. Its
+   * content is broadcast to all other ranks, which then parse it from
+   * memory. Hence, the number of file system accesses at startup does not
+   * grow with the number of ranks.
+   *
+   * All parameter structs in this file are constructed from a
+   * ParameterFile.
+   */
+  class ParameterFile
+  {
+  public:
+    /**
+     * @brief Construct a new ParameterFile object.
+     *
+     * @param parameter_filename Path to parameter file
+     * @param mpi_communicator Communicator of all ranks that need the
+     *                         parameters
+     * @param output_directory Directory for all output files of the run,
+     *                         including the trailing '/'
+     *
+     * This constructor is collective on mpi_communicator. If the file
+     * does not exist, the root rank creates a template file of the same
+     * name with all declared parameters and an exception is thrown on all
+     * ranks.
+     */
+    ParameterFile(const std::string &parameter_filename,
+                  const MPI_Comm     mpi_communicator = MPI_COMM_WORLD,
+                  const std::string &output_directory = "output/");
+
+    /**
+     * @brief Declare all parameters
+     *
+     * @param prm ParameterHandler
+     *
+     * Declare the parameters of all parameter structs. This is used to
+     * create a template file.
+     */
+    static void
+    declare_parameters(ParameterHandler &prm);
+
+    /**
+     * @brief Parse the content of the parameter file.
+     *
+     * @param prm ParameterHandler with declared parameters
+     *
+     * Entries that are not declared in prm are skipped.
+     */
+    void
+    parse(ParameterHandler &prm) const;
+
+    /**
+     * @brief Returns the path to the parameter file.
+     *
+     * @return const std::string&
+     */
+    const std::string &
+    get_filename() const;
+
+    /**
+     * @brief Returns the directory for all output files of the run.
+     *
+     * @return const std::string&
+     */
+    const std::string &
+    get_output_directory() const;
+
+  private:
+    /**
+     * Path to the parameter file
+     */
+    std::string filename;
+
+    /**
+     * Directory for all output files of the run
+     */
+    std::string output_directory;
+
+    /**
+     * Content of the parameter file
+     */
+    std::string content;
+  };
+
+
   /**
    * @brief Get the space dimesion from parameter files.
    */
@@ -37,13 +127,13 @@ namespace Elasticity
     /**
      * @brief Construct a new Dimension object.
      *
-     * @param parameter_filename Filename of the parameter file
+     * @param parameter_file Content of the parameter file
      *
      * This constructor creates the Dimension object and uses
      * declare_parameters() and parse_parameters() to
      * get the dimension #dim from a parameter file.
      */
-    Dimension(const std::string &parameter_filename);
+    Dimension(const ParameterFile &parameter_file);
 
     /**
      * @brief Declare dimension
@@ -76,6 +166,64 @@ namespace Elasticity
   };
 
 
+  /**
+   * @brief Scalings of the Lamé parameters of one material of a sweep
+   *
+   * The Lamé parameters of the material are the scalings times
+   * GlobalParameters::lambda and GlobalParameters::mu, respectively.
+   */
+  struct LameScaling
+  {
+    /**
+     * Factor for the first Lamé parameter
+     */
+    double lambda;
+
+    /**
+     * Factor for the second Lamé parameter
+     */
+    double mu;
+
+    /**
+     * @brief Checks if two scalings have the same ratio.
+     *
+     * @param other Other scaling
+     * @return bool
+     *
+     * The MsFEM basis functions only depend on the ratio of the
+     * Lamé parameters and can be reused if this is true.
+     */
+    bool
+    has_same_ratio(const LameScaling &other) const
+    {
+      return std::abs(lambda * other.mu - mu * other.lambda) <=
+             1e-12 * std::abs(mu * other.mu);
+    }
+  };
+
+
+  /**
+   * @brief Loads of a single load case
+   */
+  struct LoadCase
+  {
+    /**
+     * Mass density of the body
+     */
+    double rho;
+
+    /**
+     * Value of the surface force
+     */
+    double surface_force;
+
+    /**
+     * Rotation angle
+     */
+    double angle;
+  };
+
+
   /**
    * @brief Collection of globally needed parameters
    *
@@ -93,13 +241,19 @@ namespace Elasticity
     /**
      * @brief Construct a new GlobalParameters object
      *
-     * @param parameter_filename Path to parameter file
+     * @param parameter_file Content of the parameter file
+     * @param mpi_communicator Communicator of all ranks that construct
+     *                         this object
      *
      * This constructor creates the GlobalParameters object and uses
      * declare_parameters() and parse_parameters() to
      * get the needed parameters from a parameter file.
+     *
+     * If #shared_material_tables is set in the parameter file, this
+     * constructor is collective on mpi_communicator.
      */
-    GlobalParameters(const std::string &parameter_filename);
+    GlobalParameters(const ParameterFile &parameter_file,
+                     const MPI_Comm       mpi_communicator = MPI_COMM_WORLD);
 
     /**
      * @brief Copy constructor for GlobalParameters
@@ -108,6 +262,16 @@ namespace Elasticity
      */
     GlobalParameters(const GlobalParameters<dim> &other) = default;
 
+    /**
+     * @brief Destroy the GlobalParameters object
+     *
+     * Frees the shared material tables that this object created, copies
+     * only hold views of them. If #shared_material_tables is true, this is
+     * collective on #mpi_communicator, so the owning object must be
+     * destroyed at the same point on all ranks, and no copy may outlive it.
+     */
+    ~GlobalParameters();
+
     /**
      * @brief Declare parameters
      *
@@ -132,6 +296,48 @@ namespace Elasticity
     void
     parse_parameters(ParameterHandler &prm);
 
+    /**
+     * @brief Returns the load cases for which a linear system is solved.
+     *
+     * @return std::vector<LoadCase>
+     *
+     * Without #superposition, these are the #load_cases. With
+     * #superposition, these are a unit body force, a unit surface force
+     * (if #neumann_bc is true) and one case with only the rotation for
+     * each distinct nonzero rotation angle (if #rotate is true and dim = 3).
+     */
+    std::vector<LoadCase>
+    get_solved_load_cases() const;
+
+    /**
+     * @brief Returns the weights of the solutions of the solved load cases
+     *        that give the solution of a load case.
+     *
+     * @param load_case Index of the load case in #load_cases
+     * @return std::vector<double>
+     *
+     * The solution of #load_cases[load_case] is the linear combination of
+     * the solutions of get_solved_load_cases() with these weights.
+     */
+    std::vector<double>
+    get_superposition_weights(const unsigned int load_case) const;
+
+    /**
+     * @brief Draws another realization of the layered material.
+     *
+     * @param seed Seed of the random permutation of the layers
+     * @param mpi_communicator Communicator over which the material tables
+     *                         are shared
+     *
+     * The layer values of #lambda and #mu are permuted randomly. The seed 0
+     * gives the material of parse_parameters(). If #shared_material_tables
+     * is true, this function is collective on mpi_communicator. Tables
+     * that this object created before are freed.
+     */
+    void
+    draw_material_sample(const unsigned int seed,
+                         const MPI_Comm     mpi_communicator);
+
     /**
      * @brief Reset face id for dirichlet boundary condition?
      *
@@ -217,6 +423,46 @@ namespace Elasticity
      */
     Point<dim> neumann_p2;
 
+    /**
+     * Communicator over which the material tables of #lambda and #mu
+     * are shared.
+     */
+    MPI_Comm mpi_communicator;
+
+    /**
+     * Directory for all output files, see
+     * ParameterFile::get_output_directory().
+     */
+    std::string output_directory;
+
+    /**
+     * True if the material tables of #lambda and #mu are stored
+     * once per node in an MPI shared memory window.
+     */
+    bool shared_material_tables;
+
+    /**
+     * @brief The sort of structure of the material
+     *
+     * @see LamePrm::material_structure
+     */
+    std::map<std::string, bool> material_structure;
+
+    /**
+     * Number of layers in x-direction
+     */
+    unsigned int n_x_layers;
+
+    /**
+     * Number of layers in y-direction
+     */
+    unsigned int n_y_layers;
+
+    /**
+     * Number of layers in z-direction
+     */
+    unsigned int n_z_layers;
+
     /**
      * First Lamé parameter
      */
@@ -227,6 +473,33 @@ namespace Elasticity
      */
     LamePrm<dim> mu;
 
+    /**
+     * Mean value of the first Lamé parameter
+     */
+    double lambda_mean;
+
+    /**
+     * Mean value of the second Lamé parameter
+     */
+    double mu_mean;
+
+    /**
+     * @brief Materials of a parameter sweep
+     *
+     * The stiffness matrix is the affine combination
+     * lambda_scaling * K_lambda + mu_scaling * K_mu of the matrices
+     * that belong to #lambda and #mu. If no sweep is given in the
+     * parameter file, this only contains the scaling (1, 1).
+     */
+    std::vector<LameScaling> material_sweep;
+
+    /**
+     * True if K_lambda and K_mu shall be assembled and stored separately
+     * such that a new material of #material_sweep only needs a matrix
+     * combination instead of a new assembly.
+     */
+    bool affine_decomposition;
+
     /**
      * Mass density of the body
      */
@@ -239,24 +512,152 @@ namespace Elasticity
     double surface_force;
 
     /**
-     * Number of refinements on the coarse scale.
+     * True if one end shall be rotated.
      */
-    unsigned int coarse_refinements;
+    bool rotate;
 
     /**
-     * Number of refinements on the fine scale.
+     * Rotation angle
      */
-    unsigned int fine_refinements;
+    double angle;
 
     /**
-     * True if one end shall be rotated.
+     * @brief All load cases
+     *
+     * The operator is assembled and factorized (or its preconditioner is
+     * set up) once and all load cases are solved with it. If no load cases
+     * are given in the parameter file, this only contains the case
+     * defined by #rho, #surface_force and #angle.
      */
-    bool rotate;
+    std::vector<LoadCase> load_cases;
 
     /**
-     * Rotation angle
+     * True if the load cases shall be computed by linear superposition
+     * of the solutions for unit loads.
+     *
+     * @see get_solved_load_cases()
      */
-    double angle;
+    bool superposition;
+  };
+
+
+  /**
+   * @brief Parameters of the LinearSolver of a class
+   *
+   * These parameters live in the subsection "Linear solver" of the
+   * subsection of the class that owns the LinearSolver.
+   */
+  struct ParametersSolver
+  {
+    /**
+     * @brief Construct a new (empty) ParametersSolver object
+     */
+    ParametersSolver()
+    {}
+
+    /**
+     * @brief Copy constructor for ParametersSolver
+     *
+     * @param other ParametersSolver
+     */
+    ParametersSolver(const ParametersSolver &other) = default;
+
+    /**
+     * @brief Declare parameters
+     *
+     * @param prm ParameterHandler
+     *
+     * Declare the needed parameters for the <a href=
+     * "https://www.dealii.org/9.2.0/doxygen/deal.II/
+     * classParameterHandler.html">ParameterHandler</a> in the current
+     * subsection.
+     */
+    static void
+    declare_parameters(ParameterHandler &prm);
+
+    /**
+     * @brief Parse the parameters
+     *
+     * @param prm ParameterHandler
+     *
+     * Parse the needed parameters with the <a href=
+     * "https://www.dealii.org/9.2.0/doxygen/deal.II/
+     * classParameterHandler.html">ParameterHandler</a> in the current
+     * subsection.
+     */
+    void
+    parse_parameters(ParameterHandler &prm);
+
+    /**
+     * If true a direct solver will be used. This is set from the entry
+     * "use direct solver" of the owning class.
+     */
+    bool direct_solver;
+
+    /**
+     * Name of the Amesos solver, i.e. "Amesos_Klu", "Amesos_Mumps" or
+     * "Amesos_Superludist"
+     */
+    std::string direct_solver_type;
+
+    /**
+     * Preconditioner of the CG method: "AMG", "Chebyshev", "ILU",
+     * "block Jacobi" or "SSOR"
+     */
+    std::string preconditioner;
+
+    /**
+     * Trilinos package of the AMG preconditioner: "ML" or "MueLu"
+     */
+    std::string amg_package;
+
+    /**
+     * Smoother of the AMG preconditioner
+     */
+    std::string smoother_type;
+
+    /**
+     * Number of smoother sweeps of the AMG preconditioner
+     */
+    unsigned int smoother_sweeps;
+
+    /**
+     * Aggregation threshold of the AMG preconditioner
+     */
+    double aggregation_threshold;
+
+    /**
+     * If true, the rotations are part of the near null space of the ML
+     * preconditioner, otherwise only the translations.
+     */
+    bool rigid_body_modes;
+
+    /**
+     * Degree of the Chebyshev preconditioner
+     */
+    unsigned int chebyshev_degree;
+
+    /**
+     * Fill-in level of the ILU preconditioner
+     */
+    unsigned int ilu_fill;
+
+    /**
+     * Relaxation parameter of the block Jacobi and SSOR preconditioners
+     */
+    double relaxation;
+
+    /**
+     * If true, the iterative solver starts from the last solution of the
+     * same load case, otherwise from zero.
+     */
+    bool warm_start;
+
+    /**
+     * If true, the CG method runs in single precision inside an iterative
+     * refinement loop in double precision.
+     */
+    bool mixed_precision;
   };
 
 
@@ -268,13 +669,13 @@ namespace Elasticity
     /**
      * @brief Construct a new ParametersStd object
      *
-     * @param parameter_filename Path to parameter file
+     * @param parameter_file Content of the parameter file
      *
      * This constructor creates the ParametersStd object and uses
      * declare_parameters() and parse_parameters() to
      * get the needed parameters from a parameter file.
      */
-    ParametersStd(const std::string &parameter_filename);
+    ParametersStd(const ParameterFile &parameter_file);
 
     /**
      * @brief Copy constructor for ParametersStd
@@ -318,6 +719,18 @@ namespace Elasticity
      */
     bool direct_solver;
 
+    /**
+     * Parameters of the LinearSolver
+     */
+    ParametersSolver linear_solver;
+
+    /**
+     * If true, the iterative solver is preconditioned with the two-level
+     * Schwarz method that uses the MsFEM basis functions as coarse space.
+     * This requires the MsFEM to run first on a matching mesh.
+     */
+    bool two_level_schwarz;
+
     /**
      * Number of refinements in the first cycle
      */
@@ -339,13 +752,13 @@ namespace Elasticity
     /**
      * @brief Construct a new ParametersStd object
      *
-     * @param parameter_filename Path to parameter file
+     * @param parameter_file Content of the parameter file
      *
      * This constructor creates the ParametersMs object and uses
      * declare_parameters() and parse_parameters() to
      * get the needed parameters from a parameter file.
      */
-    ParametersMs(const std::string &parameter_filename);
+    ParametersMs(const ParameterFile &parameter_file);
 
     /**
      * @brief Copy constructor for ParametersMs
@@ -389,6 +802,34 @@ namespace Elasticity
      */
     bool direct_solver;
 
+    /**
+     * If true, the coarse cells are partitioned with weights that are
+     * proportional to the measured cost of their ElaBasis objects.
+     */
+    bool weighted_partitioning;
+
+    /**
+     * If true and #weighted_partitioning is used, the first partition is
+     * weighted with the contrast of the material in the coarse cells
+     * since no costs have been measured yet.
+     */
+    bool a_priori_weights;
+
+    /**
+     * Which processors compute the basis functions of a coarse cell:
+     *  - "owner": the owner of the cell,
+     *  - "work stealing": processors that have computed the basis functions
+     *    of their own cells take the remaining ones of other processors,
+     *  - "all processors": the cells are split evenly over all processors,
+     *    also over those without coarse cells.
+     */
+    std::string basis_scheduling;
+
+    /**
+     * Parameters of the LinearSolver
+     */
+    ParametersSolver linear_solver;
+
     /**
      * Number of refinements on the coarse level
      */
@@ -412,13 +853,13 @@ namespace Elasticity
     /**
      * @brief Construct a new ParametersBasis object
      *
-     * @param parameter_filename Path to parameter file
+     * @param parameter_file Content of the parameter file
      *
      * This constructor creates the ParametersBasis object and uses
      * declare_parameters() and parse_parameters() to
      * get the needed parameters from a parameter file.
      */
-    ParametersBasis(const std::string &parameter_filename);
+    ParametersBasis(const ParameterFile &parameter_file);
 
     /**
      * @brief Copy contructor for ParametersBasis
@@ -468,10 +909,261 @@ namespace Elasticity
      */
     bool prevent_output;
 
+    /**
+     * If true, the iterative solver of ElaBasis runs on a single-precision
+     * condensed fine-scale system. The projection onto the coarse scale
+     * stays in double precision. The direct solver ignores this option.
+     */
+    bool single_precision;
+
     /**
      * Number of refinements on the fine level
      */
     unsigned int n_refine;
+
+    /**
+     * Number of levels of the MsFEM in a coarse cell. With more than one
+     * level, the basis functions are computed with an MsFEM on an
+     * intermediate mesh with #n_refine / 2 refinements whose cells have
+     * their own basis functions with the remaining refinements and one
+     * level less.
+     */
+    unsigned int n_levels;
+
+    /**
+     * How the fine mesh of a cell is refined. "global" refines it uniformly
+     * #n_refine times. "material" refines the cells in which the Lamé
+     * parameters vary and "kelly" the cells with the largest Kelly estimate
+     * of the basis functions. The adaptive meshes are not finer than the
+     * uniform one. "anisotropic" refines all cells #n_refine times, but
+     * only in the directions in which a layered material varies.
+     */
+    std::string refinement;
+
+    /**
+     * Maximal number of fine dofs of a cell with adaptive refinement. Zero
+     * disables the limit.
+     */
+    unsigned int dof_budget;
+
+    /**
+     * Fraction of the cells that are refined in each step with the "kelly"
+     * #refinement.
+     */
+    double refinement_fraction;
+
+    /**
+     * How the tolerance of the iterative solver is chosen. With "fixed", it
+     * is #solver_tolerance times the norm of the condensed right-hand side.
+     * With "coarse error", #solver_tolerance is replaced by
+     * #safety_factor times the ratio of the coarse cell diameter and the
+     * domain diameter, an estimate of the relative error of the coarse
+     * discretization.
+     */
+    std::string tolerance_policy;
+
+    /**
+     * Relative tolerance of the "fixed" #tolerance_policy
+     */
+    double solver_tolerance;
+
+    /**
+     * Safety factor of the "coarse error" #tolerance_policy
+     */
+    double safety_factor;
+
+    /**
+     * If positive, the iterative solver also stops when the residual is
+     * reduced by this factor with respect to the initial residual.
+     */
+    double solver_reduction;
+
+    /**
+     * If positive, the basis functions of a cell are computed by a group of
+     * processors with ElaBasisDistributed if the fine mesh of the cell has
+     * more degrees of freedom than this threshold. ElaBasisDistributed
+     * refines uniformly and uses #linear_solver with #solver_tolerance and
+     * #solver_reduction, so this requires one of #n_levels, the "global"
+     * #refinement, no #single_precision and the "fixed" #tolerance_policy.
+     */
+    unsigned long long distributed_threshold;
+
+    /**
+     * Number of processors in a group of ElaBasisDistributed
+     */
+    unsigned int processes_per_cell;
+
+    /**
+     * Parameters of the LinearSolver of ElaBasisDistributed
+     */
+    ParametersSolver linear_solver;
+  };
+
+
+  /**
+   * @brief Parameters needed for ensembles of material samples
+   */
+  struct ParametersEnsemble
+  {
+    /**
+     * @brief Construct a new ParametersEnsemble object
+     *
+     * @param parameter_file Content of the parameter file
+     *
+     * This constructor creates the ParametersEnsemble object and uses
+     * declare_parameters() and parse_parameters() to
+     * get the needed parameters from a parameter file.
+     */
+    ParametersEnsemble(const ParameterFile &parameter_file);
+
+    /**
+     * @brief Copy constructor for ParametersEnsemble
+     *
+     * @param other ParametersEnsemble
+     */
+    ParametersEnsemble(const ParametersEnsemble &other) = default;
+
+    /**
+     * @brief Declare parameters
+     *
+     * @param prm ParameterHandler
+     *
+     * Declare the needed parameters for the <a href=
+     * "https://www.dealii.org/9.2.0/doxygen/deal.II/
+     * classParameterHandler.html">ParameterHandler</a>.
+     */
+    static void
+    declare_parameters(ParameterHandler &prm);
+
+    /**
+     * @brief Parse the parameters
+     *
+     * @param prm ParameterHandler
+     *
+     * Parse the needed parameters with the <a href=
+     * "https://www.dealii.org/9.2.0/doxygen/deal.II/
+     * classParameterHandler.html">ParameterHandler</a>.
+     */
+    void
+    parse_parameters(ParameterHandler &prm);
+
+    /**
+     * If true, an ensemble of material samples is computed with ElaStd
+     * instead of the single problems.
+     */
+    bool run_ensemble;
+
+    /**
+     * Verbose
+     */
+    bool verbose;
+
+    /**
+     * Number of material samples
+     */
+    unsigned int n_samples;
+
+    /**
+     * Seed of the first material sample. The samples use the seeds
+     * #first_seed, ..., #first_seed + #n_samples - 1.
+     */
+    unsigned int first_seed;
+
+    /**
+     * Number of groups of MPI ranks. Each group computes a share of the
+     * samples on its own communicator.
+     */
+    unsigned int n_groups;
+  };
+
+
+  /**
+   * @brief Parameters that control how the problems are run
+   */
+  struct ParametersRun
+  {
+    /**
+     * @brief Construct a new ParametersRun object
+     *
+     * @param parameter_file Content of the parameter file
+     *
+     * This constructor creates the ParametersRun object and uses
+     * declare_parameters() and parse_parameters() to
+     * get the needed parameters from a parameter file.
+     */
+    ParametersRun(const ParameterFile &parameter_file);
+
+    /**
+     * @brief Copy constructor for ParametersRun
+     *
+     * @param other ParametersRun
+     */
+    ParametersRun(const ParametersRun &other) = default;
+
+    /**
+     * @brief Declare parameters
+     *
+     * @param prm ParameterHandler
+     *
+     * Declare the needed parameters for the <a href=
+     * "https://www.dealii.org/9.2.0/doxygen/deal.II/
+     * classParameterHandler.html">ParameterHandler</a>.
+     */
+    static void
+    declare_parameters(ParameterHandler &prm);
+
+    /**
+     * @brief Parse the parameters
+     *
+     * @param prm ParameterHandler
+     *
+     * Parse the needed parameters with the <a href=
+     * "https://www.dealii.org/9.2.0/doxygen/deal.II/
+     * classParameterHandler.html">ParameterHandler</a>.
+     */
+    void
+    parse_parameters(ParameterHandler &prm);
+
+    /**
+     * If true, the standard FEM (ElaStd) is run.
+     */
+    bool run_std;
+
+    /**
+     * If true, the MsFEM (ElaMs) is run.
+     */
+    bool run_ms;
+
+    /**
+     * If true, the solutions are written to vtu files.
+     */
+    bool write_output;
+
+    /**
+     * If true, the difference between the fine-scale MsFEM solution and
+     * the standard FEM solution is computed in memory. This requires
+     * #run_std and #run_ms and rules out #concurrent runs.
+     */
+    bool compare;
+
+    /**
+     * If true, ElaStd and ElaMs run at the same time on disjoint
+     * groups of ranks. Otherwise, they run one after the other on all
+     * ranks.
+     */
+    bool concurrent;
+
+    /**
+     * Fraction of the ranks that run ElaStd if #concurrent is true.
+     * If zero, the fraction is estimated from the number of degrees of
+     * freedom of both methods.
+     */
+    double std_rank_fraction;
+
+    /**
+     * Verbose
+     */
+    bool verbose;
   };
 
 
@@ -11,30 +11,24 @@ namespace Elasticity
   using namespace dealii;
 
   template <int dim>
-  GlobalParameters<dim>::GlobalParameters(const std::string &parameter_filename)
+  GlobalParameters<dim>::GlobalParameters(const ParameterFile &parameter_file,
+                                          const MPI_Comm       mpi_communicator)
+    : mpi_communicator(mpi_communicator)
+    , output_directory(parameter_file.get_output_directory())
   {
     ParameterHandler prm;
 
     declare_parameters(prm);
+    parameter_file.parse(prm);
+    parse_parameters(prm);
+  }
 
-    std::ifstream parameter_file(parameter_filename);
-    if (!parameter_file)
-      {
-        parameter_file.close();
-        std::ofstream parameter_out(parameter_filename);
-        prm.print_parameters(parameter_out, ParameterHandler::Text);
-        AssertThrow(
-          false,
-          ExcMessage(
-            "Input parameter file <" + parameter_filename +
-            "> not found. Creating a template file of the same name."));
-      }
 
-    prm.parse_input(parameter_file,
-                    /* filename = */ "generated_parameter.in",
-                    /* last_line = */ "",
-                    /* skip_undefined = */ true);
-    parse_parameters(prm);
+  template <int dim>
+  GlobalParameters<dim>::~GlobalParameters()
+  {
+    lambda.free_shared_memory();
+    mu.free_shared_memory();
   }
 
 
@@ -180,6 +174,12 @@ namespace Elasticity
                           "9.81",
                           Patterns::Double(),
                           "Set the mass density.");
+
+        prm.declare_entry("shared memory tables",
+                          "false",
+                          Patterns::Bool(),
+                          "Choose whether to store the material tables "
+                          "once per node in an MPI shared memory window.");
       }
       prm.leave_subsection();
 
@@ -192,19 +192,6 @@ namespace Elasticity
       }
       prm.leave_subsection();
 
-      prm.enter_subsection("Refinements");
-      {
-        prm.declare_entry("coarse refinements",
-                          "1",
-                          Patterns::Integer(),
-                          "Set the number of refinements on the coarse scale.");
-        prm.declare_entry("fine refinements",
-                          "1",
-                          Patterns::Integer(),
-                          "Set the number of refinements on the fine scale.");
-      }
-      prm.leave_subsection();
-
       prm.enter_subsection("Rotations");
       {
         prm.declare_entry("rotate",
@@ -217,6 +204,62 @@ namespace Elasticity
                           "Set the rotation angle.");
       }
       prm.leave_subsection();
+
+      prm.enter_subsection("Material sweep");
+      {
+        prm.declare_entry("E",
+                          "",
+                          Patterns::List(Patterns::Double()),
+                          "Young's moduli of the sweep. Only used if E "
+                          "and nu are used.");
+        prm.declare_entry("nu",
+                          "",
+                          Patterns::List(Patterns::Double()),
+                          "Poisson ratios of the sweep. Only used if E "
+                          "and nu are used.");
+        prm.declare_entry("mu",
+                          "",
+                          Patterns::List(Patterns::Double()),
+                          "Mean values of the second Lamé parameter of "
+                          "the sweep. Only used if E and nu are not used.");
+        prm.declare_entry("lambda",
+                          "",
+                          Patterns::List(Patterns::Double()),
+                          "Mean values of the first Lamé parameter of "
+                          "the sweep. Only used if E and nu are not used.");
+        prm.declare_entry("affine decomposition",
+                          "false",
+                          Patterns::Bool(),
+                          "Choose whether to store the stiffness matrices "
+                          "of both Lamé parameters separately.");
+      }
+      prm.leave_subsection();
+
+      prm.enter_subsection("Load cases");
+      {
+        prm.declare_entry("rho",
+                          "",
+                          Patterns::List(Patterns::Double()),
+                          "Mass densities of the load cases. If empty, "
+                          "the mass density of the material parameters "
+                          "is used.");
+        prm.declare_entry("surface force",
+                          "",
+                          Patterns::List(Patterns::Double()),
+                          "Surface forces of the load cases. If empty, "
+                          "the surface force of the forces is used.");
+        prm.declare_entry("rotation angle",
+                          "",
+                          Patterns::List(Patterns::Double()),
+                          "Rotation angles of the load cases. If empty, "
+                          "the rotation angle of the rotations is used.");
+        prm.declare_entry("superposition",
+                          "false",
+                          Patterns::Bool(),
+                          "Choose whether to compute the load cases by "
+                          "superposition of the solutions for unit loads.");
+      }
+      prm.leave_subsection();
     }
     prm.leave_subsection();
   }
@@ -225,8 +268,13 @@ namespace Elasticity
   void
   GlobalParameters<dim>::parse_parameters(ParameterHandler &prm)
   {
-    bool                        use_E_and_nu;
-    std::map<std::string, bool> material_structure;
+    bool use_E_and_nu;
+
+    // Conversion of Young's modulus and the Poisson ratio
+    const auto lame_from_E_and_nu = [](const double E, const double nu) {
+      return std::make_pair(E * nu / ((1 + nu) * (1 - 2 * nu)),
+                            E / (2 * (1 + nu)));
+    };
 
     prm.enter_subsection("Global parameters");
     {
@@ -293,12 +341,6 @@ namespace Elasticity
 
       prm.enter_subsection("Material parameters");
       {
-        // Mean value of the first Lamé parameter
-        double lambda_mean;
-        // Mean value of the second Lamé parameter
-        double mu_mean;
-
-
         if (use_E_and_nu)
           {
             // Young's modulus/elastic modulus
@@ -306,8 +348,7 @@ namespace Elasticity
             // Poisson ratio
             double nu = prm.get_double("nu");
 
-            mu_mean     = E * nu / ((1 + nu) * (1 - 2 * nu));
-            lambda_mean = E / (2 * (1 + nu));
+            std::tie(mu_mean, lambda_mean) = lame_from_E_and_nu(E, nu);
           }
         else
           {
@@ -319,44 +360,33 @@ namespace Elasticity
 
         double lambda_fr = prm.get_double("lambda frequency");
 
-        if (material_structure.at("oscillations"))
-          {
-            lambda = LamePrm<dim>(
-              lambda_fr, lambda_mean, material_structure, init_p1, init_p2);
+        shared_material_tables = prm.get_bool("shared memory tables");
 
-            mu = LamePrm<dim>(
-              mu_fr, mu_mean, material_structure, init_p1, init_p2);
-          }
-        else
+        if (material_structure.at("oscillations"))
           {
-            unsigned int n_x_layers = prm.get_integer("n x layers");
-            unsigned int n_y_layers = prm.get_integer("n y layers");
-            unsigned int n_z_layers = prm.get_integer("n z layers");
-            unsigned int n_layers   = n_x_layers * n_y_layers * n_z_layers;
-
-            std::vector<unsigned int> index_set(n_layers);
-            std::iota(index_set.begin(), index_set.end(), 0);
-            std::seed_seq seq{1, 2, 3, 4, 5};
-            std::mt19937  rd(seq);
-            std::shuffle(index_set.begin(), index_set.end(), rd);
-
-            lambda = LamePrm<dim>(n_x_layers,
-                                  n_y_layers,
-                                  n_z_layers,
+            lambda = LamePrm<dim>(lambda_fr,
                                   lambda_mean,
-                                  index_set,
                                   material_structure,
                                   init_p1,
-                                  init_p2);
+                                  init_p2,
+                                  mpi_communicator,
+                                  shared_material_tables);
 
-            mu = LamePrm<dim>(n_x_layers,
-                              n_y_layers,
-                              n_z_layers,
+            mu = LamePrm<dim>(mu_fr,
                               mu_mean,
-                              index_set,
                               material_structure,
                               init_p1,
-                              init_p2);
+                              init_p2,
+                              mpi_communicator,
+                              shared_material_tables);
+          }
+        else
+          {
+            n_x_layers = prm.get_integer("n x layers");
+            n_y_layers = prm.get_integer("n y layers");
+            n_z_layers = prm.get_integer("n z layers");
+
+            draw_material_sample(0, mpi_communicator);
           }
 
         rho = prm.get_double("rho");
@@ -369,22 +399,209 @@ namespace Elasticity
       }
       prm.leave_subsection();
 
-      prm.enter_subsection("Refinements");
+      prm.enter_subsection("Rotations");
       {
-        coarse_refinements = prm.get_integer("coarse refinements");
-        fine_refinements   = prm.get_integer("fine refinements");
+        rotate = prm.get_bool("rotate");
+        angle  = prm.get_double("rotation angle") * M_PI;
       }
       prm.leave_subsection();
 
-      prm.enter_subsection("Rotations");
+      prm.enter_subsection("Material sweep");
       {
-        rotate = prm.get_bool("rotate");
-        angle  = prm.get_double("rotation angle") * M_PI;
+        const std::vector<double> first_list = Utilities::string_to_double(
+          Utilities::split_string_list(prm.get(use_E_and_nu ? "E" : "mu")));
+        const std::vector<double> second_list =
+          Utilities::string_to_double(Utilities::split_string_list(
+            prm.get(use_E_and_nu ? "nu" : "lambda")));
+
+        AssertThrow(first_list.size() == second_list.size(),
+                    ExcMessage("The lists of the material sweep must have "
+                               "the same number of entries."));
+        AssertThrow(first_list.empty() || (lambda_mean != 0. && mu_mean != 0.),
+                    ExcMessage("A material sweep needs nonzero mean "
+                               "values of the Lamé parameters."));
+
+        material_sweep.clear();
+        for (unsigned int i = 0; i < first_list.size(); ++i)
+          {
+            double mu_value, lambda_value;
+            if (use_E_and_nu)
+              std::tie(mu_value, lambda_value) =
+                lame_from_E_and_nu(first_list[i], second_list[i]);
+            else
+              std::tie(mu_value, lambda_value) =
+                std::make_pair(first_list[i], second_list[i]);
+
+            material_sweep.push_back(
+              LameScaling{lambda_value / lambda_mean, mu_value / mu_mean});
+          }
+
+        if (material_sweep.empty())
+          material_sweep.push_back(LameScaling{1., 1.});
+
+        affine_decomposition = prm.get_bool("affine decomposition");
+      }
+      prm.leave_subsection();
+
+      prm.enter_subsection("Load cases");
+      {
+        std::vector<double> rho_list = Utilities::string_to_double(
+          Utilities::split_string_list(prm.get("rho")));
+        std::vector<double> surface_force_list = Utilities::string_to_double(
+          Utilities::split_string_list(prm.get("surface force")));
+        std::vector<double> angle_list = Utilities::string_to_double(
+          Utilities::split_string_list(prm.get("rotation angle")));
+
+        const unsigned int n_load_cases =
+          std::max(std::max(rho_list.size(), surface_force_list.size()),
+                   std::max(angle_list.size(), std::size_t(1)));
+
+        // Empty lists are replaced by the single value that is given
+        // outside of this subsection and lists with a single entry are used
+        // for all load cases.
+        for (std::vector<double> *list :
+             {&rho_list, &surface_force_list, &angle_list})
+          {
+            AssertThrow(list->size() <= 1 || list->size() == n_load_cases,
+                        ExcMessage("All lists of load cases must have "
+                                   "either one or the same number of "
+                                   "entries."));
+          }
+        if (rho_list.empty())
+          rho_list.push_back(rho);
+        if (surface_force_list.empty())
+          surface_force_list.push_back(surface_force);
+        if (angle_list.empty())
+          angle_list.push_back(angle / M_PI);
+
+        load_cases.resize(n_load_cases);
+        for (unsigned int i = 0; i < n_load_cases; ++i)
+          {
+            load_cases[i].rho = rho_list[rho_list.size() == 1 ? 0 : i];
+            load_cases[i].surface_force =
+              surface_force_list[surface_force_list.size() == 1 ? 0 : i];
+            load_cases[i].angle =
+              angle_list[angle_list.size() == 1 ? 0 : i] * M_PI;
+          }
+
+        superposition = prm.get_bool("superposition");
       }
       prm.leave_subsection();
     }
     prm.leave_subsection();
   }
+
+
+  template <int dim>
+  void
+  GlobalParameters<dim>::draw_material_sample(const unsigned int seed,
+                                              const MPI_Comm mpi_communicator)
+  {
+    AssertThrow(!material_structure.at("oscillations"),
+                ExcMessage("Material samples need a layered material."));
+
+    this->mpi_communicator = mpi_communicator;
+
+    unsigned int n_layers = n_x_layers * n_y_layers * n_z_layers;
+
+    std::vector<unsigned int> index_set(n_layers);
+    std::iota(index_set.begin(), index_set.end(), 0);
+    // The seed 0 reproduces the fixed seed sequence of a single run.
+    std::vector<unsigned int> seeds{1, 2, 3, 4, 5};
+    if (seed != 0)
+      seeds.push_back(seed);
+    std::seed_seq seq(seeds.begin(), seeds.end());
+    std::mt19937  rd(seq);
+    std::shuffle(index_set.begin(), index_set.end(), rd);
+
+    // The tables of the previous sample are freed here, where all ranks
+    // are together, and not where their last view happens to die.
+    lambda.free_shared_memory();
+    mu.free_shared_memory();
+
+    lambda = LamePrm<dim>(n_x_layers,
+                          n_y_layers,
+                          n_z_layers,
+                          lambda_mean,
+                          index_set,
+                          material_structure,
+                          init_p1,
+                          init_p2,
+                          mpi_communicator,
+                          shared_material_tables);
+
+    mu = LamePrm<dim>(n_x_layers,
+                      n_y_layers,
+                      n_z_layers,
+                      mu_mean,
+                      index_set,
+                      material_structure,
+                      init_p1,
+                      init_p2,
+                      mpi_communicator,
+                      shared_material_tables);
+  }
+
+
+  template <int dim>
+  std::vector<LoadCase>
+  GlobalParameters<dim>::get_solved_load_cases() const
+  {
+    if (!superposition)
+      return load_cases;
+
+    // unit body force
+    std::vector<LoadCase> solved_load_cases(1, LoadCase{1., 0., 0.});
+
+    // unit surface force
+    if (neumann_bc)
+      solved_load_cases.push_back(LoadCase{0., 1., 0.});
+
+    // rotations (these are not linear in the angle)
+    if (rotate && dim == 3)
+      for (const LoadCase &load_case : load_cases)
+        {
+          bool is_new_angle = (load_case.angle != 0.);
+          for (const LoadCase &solved_load_case : solved_load_cases)
+            if (solved_load_case.angle == load_case.angle)
+              is_new_angle = false;
+
+          if (is_new_angle)
+            solved_load_cases.push_back(LoadCase{0., 0., load_case.angle});
+        }
+
+    return solved_load_cases;
+  }
+
+
+  template <int dim>
+  std::vector<double>
+  GlobalParameters<dim>::get_superposition_weights(
+    const unsigned int load_case) const
+  {
+    AssertIndexRange(load_case, load_cases.size());
+
+    const std::vector<LoadCase> solved_load_cases = get_solved_load_cases();
+    std::vector<double>         weights(solved_load_cases.size(), 0.);
+
+    if (!superposition)
+      {
+        weights[load_case] = 1.;
+        return weights;
+      }
+
+    unsigned int i = 0;
+    weights[i++]   = load_cases[load_case].rho;
+
+    if (neumann_bc)
+      weights[i++] = load_cases[load_case].surface_force;
+
+    for (; i < solved_load_cases.size(); ++i)
+      if (solved_load_cases[i].angle == load_cases[load_case].angle)
+        weights[i] = 1.;
+
+    return weights;
+  }
 } // namespace Elasticity
 
 #endif /* _INCLUDE_PARAMETER_FILE_TPP_ */
\ No newline at end of file
@@ -15,18 +15,50 @@ namespace Elasticity
   /**
    * @brief Run the 2D problem
    *
-   * @param input_file Path to parameter file
+   * @param parameter_file Content of the parameter file
+   * @param mpi_communicator Communicator of all ranks that run the problem
    */
   void
-  run_2d_problem(const std::string &input_file);
+  run_2d_problem(const ParameterFile &parameter_file,
+                 const MPI_Comm       mpi_communicator = MPI_COMM_WORLD);
 
   /**
    * @brief Run the 3D problem
    *
-   * @param input_file Path to parameter file
+   * @param parameter_file Content of the parameter file
+   * @param mpi_communicator Communicator of all ranks that run the problem
    */
   void
-  run_3d_problem(const std::string &input_file);
+  run_3d_problem(const ParameterFile &parameter_file,
+                 const MPI_Comm       mpi_communicator = MPI_COMM_WORLD);
+
+  /**
+   * @brief Run the 2D or 3D problem depending on the parameter file
+   *
+   * @param parameter_file Content of the parameter file
+   * @param mpi_communicator Communicator of all ranks that run the problem
+   */
+  void
+  run_problem(const ParameterFile &parameter_file,
+              const MPI_Comm       mpi_communicator = MPI_COMM_WORLD);
+
+  /**
+   * @brief Run the problems of several parameter files in one job
+   *
+   * @param parameter_filenames Paths to the parameter files
+   * @param n_groups Number of groups of ranks
+   *
+   * MPI_COMM_WORLD is split into n_groups groups of consecutive ranks
+   * (at most one group per rank and per parameter file). The parameter
+   * files are distributed round-robin over the groups and each group
+   * runs its problems one after the other on its own communicator.
+   *
+   * The output of the i-th parameter file is written to
+   * output/iii-<name of the parameter file>/.
+   */
+  void
+  run_problems(const std::vector<std::string> &parameter_filenames,
+               const unsigned int              n_groups);
 } // namespace Elasticity
 
 #endif // _RUN_PROBLEM_H_
\ No newline at end of file
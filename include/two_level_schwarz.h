@@ -0,0 +1,180 @@
+#ifndef _INCLUDE_TWO_LEVEL_SCHWARZ_H_
+#define _INCLUDE_TWO_LEVEL_SCHWARZ_H_
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/base/mpi.h>
+
+#include <deal.II/dofs/dof_handler.h>
+
+#include <deal.II/lac/affine_constraints.h>
+#include <deal.II/lac/dynamic_sparsity_pattern.h>
+#include <deal.II/lac/solver_control.h>
+#include <deal.II/lac/sparse_direct.h>
+#include <deal.II/lac/sparse_matrix.h>
+#include <deal.II/lac/sparsity_pattern.h>
+#include <deal.II/lac/trilinos_solver.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+#include <deal.II/lac/trilinos_vector.h>
+
+#include "ela_ms.h"
+#include "mytools.h"
+
+// STL
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * @file two_level_schwarz.h
+ *
+ * @brief Two-level additive Schwarz preconditioner
+ */
+
+namespace Elasticity
+{
+  using namespace dealii;
+
+  /**
+   * @brief Two-level additive Schwarz preconditioner with the MsFEM space
+   *        as coarse space.
+   *
+   * @tparam dim Space dimension
+   *
+   * This class preconditions the system matrix of ElaStd with
+   * \f[
+   *    P^{-1} = \Phi A_0^{-1} \Phi^T + \sum_K R_K^T A_K^{-1} R_K,
+   * \f]
+   * where \f$\Phi\f$ contains the MsFEM basis functions of ElaMs/ElaBasis
+   * as fine-scale vectors and \f$A_0 = \Phi^T A \Phi\f$ is the MsFEM
+   * matrix of the fine operator.
+   *
+   * The local problems \f$A_K\f$ live on the closure of the coarse cells
+   * K, so neighboring subdomains overlap by the fine degrees of freedom on
+   * the coarse faces. Each rank only takes its locally owned degrees of
+   * freedom into the subdomains, so a coarse cell that is split between
+   * ranks yields one subdomain per rank. The subdomains, and with them the
+   * preconditioner and the number of iterations, therefore depend on the
+   * number of ranks and on the partition of the fine mesh. The local
+   * problems are factorized with UMFPACK, the coarse problem with a
+   * parallel direct solver.
+   *
+   * The coarse space contains the MsFEM basis functions, which resolve the
+   * material on the fine scale. How the number of iterations depends on
+   * the contrast of the material has not been measured.
+   *
+   * The fine mesh of ElaStd must be the coarse mesh of ElaMs refined as
+   * often as the fine mesh of ElaBasis, and both classes must live on the
+   * same communicator.
+   */
+  template <int dim>
+  class TwoLevelSchwarzPreconditioner
+  {
+  public:
+    /**
+     * @brief Construct a new TwoLevelSchwarzPreconditioner object.
+     *
+     * @param mpi_communicator The MPI communicator
+     */
+    TwoLevelSchwarzPreconditioner(const MPI_Comm mpi_communicator);
+
+    /**
+     * @brief Checks if the coarse space fits the fine mesh.
+     *
+     * @param dof_handler DoFHandler of the fine system
+     * @param coarse_space ElaMs after run()
+     * @return true if the fine mesh is the refined coarse mesh
+     */
+    static bool
+    is_compatible(const DoFHandler<dim> &dof_handler,
+                  const ElaMs<dim> &     coarse_space);
+
+    /**
+     * @brief Sets up the preconditioner.
+     *
+     * @param system_matrix System matrix of the fine problem
+     * @param dof_handler DoFHandler of the fine system
+     * @param constraints Constraints of the fine system
+     * @param coarse_space ElaMs after run()
+     *
+     * This function is collective on the communicator.
+     */
+    void
+    initialize(const TrilinosWrappers::SparseMatrix &system_matrix,
+               const DoFHandler<dim> &               dof_handler,
+               const AffineConstraints<double> &     constraints,
+               const ElaMs<dim> &                    coarse_space);
+
+    /**
+     * @brief Applies the preconditioner.
+     *
+     * @param dst Result
+     * @param src Residual
+     */
+    void
+    vmult(TrilinosWrappers::MPI::Vector &      dst,
+          const TrilinosWrappers::MPI::Vector &src) const;
+
+  private:
+    /**
+     * @brief Sets up the #prolongation from the basis functions.
+     *
+     * @param dof_handler DoFHandler of the fine system
+     * @param constraints Constraints of the fine system
+     * @param coarse_space ElaMs after run()
+     *
+     * Each rank requests the basis functions of the coarse cells that
+     * contain its locally owned fine cells from the owners of these coarse
+     * cells.
+     *
+     * The rows of constrained fine dofs stay empty. Their rows in the
+     * system matrix only hold the diagonal entry, so they would add
+     * artificial stiffness to the coarse matrix, and the coarse correction
+     * has to vanish on the Dirichlet boundary.
+     */
+    void
+    setup_prolongation(const DoFHandler<dim> &          dof_handler,
+                       const AffineConstraints<double> &constraints,
+                       const ElaMs<dim> &               coarse_space);
+
+    /**
+     * @brief Sets up and factorizes the local problems.
+     *
+     * @param system_matrix System matrix of the fine problem
+     * @param dof_handler DoFHandler of the fine system
+     * @param coarse_level Level of the coarse cells in the fine mesh
+     */
+    void
+    setup_subdomains(const TrilinosWrappers::SparseMatrix &system_matrix,
+                     const DoFHandler<dim> &               dof_handler,
+                     const unsigned int                    coarse_level);
+
+    /**
+     * @brief Sets up and factorizes the coarse problem.
+     *
+     * @param system_matrix System matrix of the fine problem
+     */
+    void
+    setup_coarse_problem(const TrilinosWrappers::SparseMatrix &system_matrix);
+
+    MPI_Comm                                          mpi_communicator;
+    IndexSet                                          coarse_owned_dofs;
+    TrilinosWrappers::SparseMatrix                    prolongation;
+    TrilinosWrappers::SparseMatrix                    coarse_matrix;
+    SolverControl                                     coarse_solver_control;
+    std::unique_ptr<TrilinosWrappers::SolverDirect>   coarse_solver;
+    std::vector<std::vector<types::global_dof_index>> subdomain_dofs;
+    std::vector<std::unique_ptr<SparseDirectUMFPACK>> subdomain_solvers;
+    mutable TrilinosWrappers::MPI::Vector             coarse_rhs;
+    mutable TrilinosWrappers::MPI::Vector             coarse_solution;
+  };
+
+  // exernal template instantiations
+  extern template class TwoLevelSchwarzPreconditioner<2>;
+  extern template class TwoLevelSchwarzPreconditioner<3>;
+} // namespace Elasticity
+
+#endif // _INCLUDE_TWO_LEVEL_SCHWARZ_H_
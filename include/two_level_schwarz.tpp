@@ -0,0 +1,353 @@
+#ifndef _INCLUDE_TWO_LEVEL_SCHWARZ_TPP_
+#define _INCLUDE_TWO_LEVEL_SCHWARZ_TPP_
+
+#include "two_level_schwarz.h"
+
+namespace Elasticity
+{
+  using namespace dealii;
+
+  /****************************************************************************/
+  /* Two-level additive Schwarz preconditioner */
+
+  template <int dim>
+  TwoLevelSchwarzPreconditioner<dim>::TwoLevelSchwarzPreconditioner(
+    const MPI_Comm mpi_communicator)
+    : mpi_communicator(mpi_communicator)
+    , coarse_solver_control()
+  {}
+
+
+  template <int dim>
+  bool
+  TwoLevelSchwarzPreconditioner<dim>::is_compatible(
+    const DoFHandler<dim> &dof_handler,
+    const ElaMs<dim>      &coarse_space)
+  {
+    const Triangulation<dim> &coarse_triangulation =
+      coarse_space.get_dof_handler().get_triangulation();
+
+    return (dof_handler.get_triangulation().n_global_levels() ==
+            coarse_triangulation.n_global_levels() +
+              coarse_space.get_n_basis_refinements());
+  }
+
+
+  template <int dim>
+  void
+  TwoLevelSchwarzPreconditioner<dim>::initialize(
+    const TrilinosWrappers::SparseMatrix &system_matrix,
+    const DoFHandler<dim>                &dof_handler,
+    const AffineConstraints<double>      &constraints,
+    const ElaMs<dim>                     &coarse_space)
+  {
+    AssertThrow(is_compatible(dof_handler, coarse_space),
+                ExcMessage("The fine mesh is not the refined coarse mesh of "
+                           "the MsFEM."));
+
+    const unsigned int coarse_level =
+      coarse_space.get_dof_handler().get_triangulation().n_global_levels() - 1;
+
+    setup_prolongation(dof_handler, constraints, coarse_space);
+    setup_subdomains(system_matrix, dof_handler, coarse_level);
+    setup_coarse_problem(system_matrix);
+  }
+
+
+  template <int dim>
+  void
+  TwoLevelSchwarzPreconditioner<dim>::setup_prolongation(
+    const DoFHandler<dim>           &dof_handler,
+    const AffineConstraints<double> &constraints,
+    const ElaMs<dim>                &coarse_space)
+  {
+    const DoFHandler<dim> &coarse_dof_handler = coarse_space.get_dof_handler();
+    const FiniteElement<dim> &fe              = dof_handler.get_fe();
+    const unsigned int        dofs_per_cell   = fe.dofs_per_cell;
+
+    const unsigned int coarse_level =
+      coarse_dof_handler.get_triangulation().n_global_levels() - 1;
+    const unsigned int n_intervals =
+      Utilities::pow(2, coarse_space.get_n_basis_refinements());
+
+    // Coarse dof indices of a coarse cell and the values of its basis
+    // functions at the fine vertices
+    const unsigned int n_values_per_coarse_cell =
+      dofs_per_cell +
+      dim * Utilities::pow(n_intervals + 1, dim) * dofs_per_cell;
+
+    coarse_owned_dofs = coarse_dof_handler.locally_owned_dofs();
+
+    // Every rank needs to know the owners of the coarse cells. There are
+    // only few of them.
+    std::map<std::string, CellId> owned_coarse_cells;
+    for (const auto &cell : coarse_dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+        owned_coarse_cells.emplace(cell->id().to_string(), cell->id());
+
+    std::vector<std::string> owned_coarse_cell_ids;
+    for (const auto &coarse_cell : owned_coarse_cells)
+      owned_coarse_cell_ids.push_back(coarse_cell.first);
+
+    const std::vector<std::vector<std::string>> all_coarse_cell_ids =
+      Utilities::MPI::all_gather(mpi_communicator, owned_coarse_cell_ids);
+
+    std::map<std::string, unsigned int> coarse_cell_owner;
+    for (unsigned int rank = 0; rank < all_coarse_cell_ids.size(); ++rank)
+      for (const std::string &id : all_coarse_cell_ids[rank])
+        coarse_cell_owner[id] = rank;
+
+    // Request the basis functions of all coarse cells that contain locally
+    // owned fine cells.
+    std::map<unsigned int, std::vector<std::string>> requests;
+    std::set<std::string>                            requested_ids;
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+        {
+          const std::string id =
+            cell->ancestor(coarse_level)->id().to_string();
+          if (requested_ids.insert(id).second)
+            requests[coarse_cell_owner.at(id)].push_back(id);
+        }
+
+    const std::map<unsigned int, std::vector<std::string>> received_requests =
+      Utilities::MPI::some_to_some(mpi_communicator, requests);
+
+    std::map<unsigned int, std::vector<double>> answers;
+    std::vector<types::global_dof_index>        coarse_dof_indices;
+    std::vector<double>                         basis_values;
+    for (const auto &request : received_requests)
+      {
+        std::vector<double> &answer = answers[request.first];
+        for (const std::string &id : request.second)
+          {
+            coarse_space.get_basis_values_on_lattice(owned_coarse_cells.at(id),
+                                                     coarse_dof_indices,
+                                                     basis_values);
+            answer.insert(answer.end(),
+                          coarse_dof_indices.begin(),
+                          coarse_dof_indices.end());
+            answer.insert(answer.end(),
+                          basis_values.begin(),
+                          basis_values.end());
+          }
+      }
+
+    const std::map<unsigned int, std::vector<double>> received_answers =
+      Utilities::MPI::some_to_some(mpi_communicator, answers);
+
+    std::map<std::string, std::vector<double>> coarse_cell_values;
+    for (const auto &answer : received_answers)
+      {
+        const std::vector<std::string> &ids = requests.at(answer.first);
+        AssertDimension(answer.second.size(),
+                        ids.size() * n_values_per_coarse_cell);
+
+        for (unsigned int i = 0; i < ids.size(); ++i)
+          coarse_cell_values[ids[i]] = std::vector<double>(
+            answer.second.begin() + i * n_values_per_coarse_cell,
+            answer.second.begin() + (i + 1) * n_values_per_coarse_cell);
+      }
+
+    // Each locally owned fine dof gets the values of the basis functions
+    // of its coarse cell. Dofs on coarse faces get the same values from
+    // both sides since the basis functions are continuous. Constrained
+    // dofs are left out.
+    const IndexSet &fine_owned_dofs = dof_handler.locally_owned_dofs();
+
+    DynamicSparsityPattern dsp(dof_handler.n_dofs(),
+                               coarse_dof_handler.n_dofs(),
+                               fine_owned_dofs);
+    std::vector<
+      std::tuple<types::global_dof_index, types::global_dof_index, double>>
+      entries;
+
+    std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+        {
+          const auto coarse_cell = cell->ancestor(coarse_level);
+          const std::vector<double> &values =
+            coarse_cell_values.at(coarse_cell->id().to_string());
+
+          const Point<dim> p1 = coarse_cell->vertex(0);
+          const Point<dim> p2 =
+            coarse_cell->vertex(GeometryInfo<dim>::vertices_per_cell - 1);
+
+          cell->get_dof_indices(local_dof_indices);
+          for (unsigned int k = 0; k < dofs_per_cell; ++k)
+            {
+              if (!fine_owned_dofs.is_element(local_dof_indices[k]) ||
+                  constraints.is_constrained(local_dof_indices[k]))
+                continue;
+
+              const std::pair<unsigned int, unsigned int>
+                component_and_vertex = fe.system_to_component_index(k);
+              const Point<dim> vertex =
+                cell->vertex(component_and_vertex.second);
+              const unsigned int entry =
+                component_and_vertex.first +
+                dim * MyTools::get_lattice_index(vertex, p1, p2, n_intervals);
+
+              for (unsigned int i = 0; i < dofs_per_cell; ++i)
+                {
+                  const double value =
+                    values[dofs_per_cell + entry * dofs_per_cell + i];
+                  if (value == 0.)
+                    continue;
+
+                  const types::global_dof_index coarse_dof_index =
+                    static_cast<types::global_dof_index>(values[i]);
+                  dsp.add(local_dof_indices[k], coarse_dof_index);
+                  entries.emplace_back(local_dof_indices[k],
+                                       coarse_dof_index,
+                                       value);
+                }
+            }
+        }
+
+    prolongation.reinit(fine_owned_dofs,
+                        coarse_owned_dofs,
+                        dsp,
+                        mpi_communicator);
+    for (const auto &entry : entries)
+      prolongation.set(std::get<0>(entry),
+                       std::get<1>(entry),
+                       std::get<2>(entry));
+    prolongation.compress(VectorOperation::insert);
+  }
+
+
+  template <int dim>
+  void
+  TwoLevelSchwarzPreconditioner<dim>::setup_subdomains(
+    const TrilinosWrappers::SparseMatrix &system_matrix,
+    const DoFHandler<dim>                &dof_handler,
+    const unsigned int                    coarse_level)
+  {
+    const IndexSet &   fine_owned_dofs = dof_handler.locally_owned_dofs();
+    const unsigned int dofs_per_cell   = dof_handler.get_fe().dofs_per_cell;
+
+    // One subdomain per coarse cell with the locally owned dofs of its
+    // closure
+    std::map<std::string, unsigned int> subdomain_index;
+    subdomain_dofs.clear();
+
+    std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+        {
+          const std::string id =
+            cell->ancestor(coarse_level)->id().to_string();
+          const auto inserted =
+            subdomain_index.emplace(id, subdomain_dofs.size());
+          if (inserted.second)
+            subdomain_dofs.emplace_back();
+
+          std::vector<types::global_dof_index> &dofs =
+            subdomain_dofs[inserted.first->second];
+
+          cell->get_dof_indices(local_dof_indices);
+          for (const types::global_dof_index dof_index : local_dof_indices)
+            if (fine_owned_dofs.is_element(dof_index))
+              dofs.push_back(dof_index);
+        }
+
+    subdomain_solvers.clear();
+    subdomain_solvers.reserve(subdomain_dofs.size());
+
+    for (std::vector<types::global_dof_index> &dofs : subdomain_dofs)
+      {
+        std::sort(dofs.begin(), dofs.end());
+        dofs.erase(std::unique(dofs.begin(), dofs.end()), dofs.end());
+
+        // Local index of a global dof or dofs.size() if it is not in the
+        // subdomain
+        const auto local_index = [&dofs](const types::global_dof_index i) {
+          const auto it = std::lower_bound(dofs.begin(), dofs.end(), i);
+          return static_cast<unsigned int>(
+            (it != dofs.end() && *it == i) ? it - dofs.begin() : dofs.size());
+        };
+
+        DynamicSparsityPattern dsp(dofs.size(), dofs.size());
+        for (unsigned int i = 0; i < dofs.size(); ++i)
+          for (auto entry = system_matrix.begin(dofs[i]);
+               entry != system_matrix.end(dofs[i]);
+               ++entry)
+            {
+              const unsigned int j = local_index(entry->column());
+              if (j < dofs.size())
+                dsp.add(i, j);
+            }
+
+        SparsityPattern sparsity_pattern;
+        sparsity_pattern.copy_from(dsp);
+
+        SparseMatrix<double> local_matrix(sparsity_pattern);
+        for (unsigned int i = 0; i < dofs.size(); ++i)
+          for (auto entry = system_matrix.begin(dofs[i]);
+               entry != system_matrix.end(dofs[i]);
+               ++entry)
+            {
+              const unsigned int j = local_index(entry->column());
+              if (j < dofs.size())
+                local_matrix.set(i, j, entry->value());
+            }
+
+        // UMFPACK keeps its own copy of the matrix.
+        subdomain_solvers.push_back(std::make_unique<SparseDirectUMFPACK>());
+        subdomain_solvers.back()->factorize(local_matrix);
+      }
+  }
+
+
+  template <int dim>
+  void
+  TwoLevelSchwarzPreconditioner<dim>::setup_coarse_problem(
+    const TrilinosWrappers::SparseMatrix &system_matrix)
+  {
+    // A_0 = P^T A P
+    TrilinosWrappers::SparseMatrix matrix_times_prolongation;
+    system_matrix.mmult(matrix_times_prolongation, prolongation);
+    prolongation.Tmmult(coarse_matrix, matrix_times_prolongation);
+
+    coarse_solver =
+      std::make_unique<TrilinosWrappers::SolverDirect>(coarse_solver_control);
+    coarse_solver->initialize(coarse_matrix);
+
+    coarse_rhs.reinit(coarse_owned_dofs, mpi_communicator);
+    coarse_solution.reinit(coarse_owned_dofs, mpi_communicator);
+  }
+
+
+  template <int dim>
+  void
+  TwoLevelSchwarzPreconditioner<dim>::vmult(
+    TrilinosWrappers::MPI::Vector       &dst,
+    const TrilinosWrappers::MPI::Vector &src) const
+  {
+    dst = 0;
+
+    // local corrections
+    Vector<double> local_values;
+    for (unsigned int s = 0; s < subdomain_dofs.size(); ++s)
+      {
+        const std::vector<types::global_dof_index> &dofs = subdomain_dofs[s];
+
+        local_values.reinit(dofs.size());
+        src.extract_subvector_to(dofs.begin(),
+                                 dofs.end(),
+                                 local_values.begin());
+        subdomain_solvers[s]->solve(local_values);
+        dst.add(dofs, local_values);
+      }
+    dst.compress(VectorOperation::add);
+
+    // coarse correction
+    prolongation.Tvmult(coarse_rhs, src);
+    coarse_solver->solve(coarse_solution, coarse_rhs);
+    prolongation.vmult_add(dst, coarse_solution);
+  }
+} // namespace Elasticity
+
+#endif // _INCLUDE_TWO_LEVEL_SCHWARZ_TPP_
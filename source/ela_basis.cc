@@ -5,6 +5,25 @@
 
 namespace Elasticity
 {
+  std::vector<double>
+  pack_element_system(const Vector<double>                          &rhs,
+                      const std::vector<const FullMatrix<double> *> &matrices)
+  {
+    std::vector<double> result(rhs.begin(), rhs.end());
+
+    // The entries of a FullMatrix are stored row by row.
+    for (const FullMatrix<double> *matrix : matrices)
+      result.insert(result.end(),
+                    &(*matrix)(0, 0),
+                    &(*matrix)(0, 0) + matrix->n_elements());
+
+    return result;
+  }
+
+
+  template class ElaLocalAssembler<2>;
+  template class ElaLocalAssembler<3>;
+
   template class ElaBasis<2>;
   template class ElaBasis<3>;
 } // namespace Elasticity
\ No newline at end of file
@@ -0,0 +1,10 @@
+#include "ela_basis_distributed.h"
+
+#include "ela_basis_distributed.tpp"
+
+
+namespace Elasticity
+{
+  template class ElaBasisDistributed<2>;
+  template class ElaBasisDistributed<3>;
+} // namespace Elasticity
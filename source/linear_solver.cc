@@ -0,0 +1,100 @@
+#include "linear_solver.h"
+
+#include "linear_solver.tpp"
+
+namespace Elasticity
+{
+  template class LinearSolver<2>;
+  template class LinearSolver<3>;
+
+  using namespace dealii;
+
+  /****************************************************************************/
+  /* Single-precision copy of a Trilinos matrix */
+
+  void
+  SinglePrecisionMatrix::reinit(const TrilinosWrappers::SparseMatrix &matrix)
+  {
+    const IndexSet owned_rows = matrix.locally_owned_range_indices();
+
+    IndexSet ghost_columns(matrix.n());
+    for (const types::global_dof_index row : owned_rows)
+      for (auto entry = matrix.begin(row); entry != matrix.end(row); ++entry)
+        if (!owned_rows.is_element(entry->column()))
+          ghost_columns.add_index(entry->column());
+    ghost_columns.compress();
+
+    partitioner = std::make_shared<const Utilities::MPI::Partitioner>(
+      owned_rows, ghost_columns, matrix.get_mpi_communicator());
+
+    row_starts.assign(1, 0);
+    columns.clear();
+    values.clear();
+    for (const types::global_dof_index row : owned_rows)
+      {
+        for (auto entry = matrix.begin(row); entry != matrix.end(row); ++entry)
+          {
+            columns.push_back(partitioner->global_to_local(entry->column()));
+            values.push_back(static_cast<float>(entry->value()));
+          }
+        row_starts.push_back(columns.size());
+      }
+  }
+
+
+  void
+  SinglePrecisionMatrix::vmult(VectorType &dst, const VectorType &src) const
+  {
+    src.update_ghost_values();
+
+    for (unsigned int row = 0; row < row_starts.size() - 1; ++row)
+      {
+        float sum = 0;
+        for (unsigned int k = row_starts[row]; k < row_starts[row + 1]; ++k)
+          sum += values[k] * src.local_element(columns[k]);
+        dst.local_element(row) = sum;
+      }
+
+    src.zero_out_ghosts();
+  }
+
+
+  void
+  SinglePrecisionMatrix::initialize_dof_vector(VectorType &vector) const
+  {
+    vector.reinit(partitioner);
+  }
+
+
+  std::shared_ptr<DiagonalMatrix<SinglePrecisionMatrix::VectorType>>
+  SinglePrecisionMatrix::get_inverse_diagonal() const
+  {
+    auto inverse_diagonal = std::make_shared<DiagonalMatrix<VectorType>>();
+
+    VectorType &diagonal_vector = inverse_diagonal->get_vector();
+    initialize_dof_vector(diagonal_vector);
+
+    // The local index of an owned column is the local index of its row.
+    for (unsigned int row = 0; row < row_starts.size() - 1; ++row)
+      for (unsigned int k = row_starts[row]; k < row_starts[row + 1]; ++k)
+        if (columns[k] == row && values[k] != 0.f)
+          diagonal_vector.local_element(row) = 1.f / values[k];
+
+    return inverse_diagonal;
+  }
+
+
+  types::global_dof_index
+  SinglePrecisionMatrix::m() const
+  {
+    return partitioner->size();
+  }
+
+
+  types::global_dof_index
+  SinglePrecisionMatrix::n() const
+  {
+    return partitioner->size();
+  }
+
+} // namespace Elasticity
@@ -7,11 +7,15 @@ main(int argc, char *argv[])
   if (argc < 2)
     {
       std::cout << "You must provide an input file \"-p <filename>\""
-                << std::endl;
+                << std::endl
+                << "Several input files \"-p <filename> <filename> ...\" "
+                << "are run on \"-g <groups>\" groups of ranks "
+                << "(default: one group per input file)." << std::endl;
       exit(1);
     }
 
-  std::string input_file = "";
+  std::vector<std::string> input_files;
+  unsigned int             n_groups = 0;
 
   std::list<std::string> args;
   for (int i = 1; i < argc; ++i)
@@ -32,7 +36,38 @@ main(int argc, char *argv[])
           else
             {
               args.pop_front();
-              input_file = args.front();
+              while (args.size() && args.front()[0] != '-')
+                {
+                  input_files.push_back(args.front());
+                  args.pop_front();
+                }
+            }
+        }
+      else if (args.front() == std::string("-g"))
+        {
+          if (args.size() == 1)
+            {
+              std::cerr << "Error: flag '-g' must be followed by the "
+                        << "number of groups." << std::endl;
+              exit(1);
+            }
+          else
+            {
+              args.pop_front();
+
+              // At most nine digits, so the number fits into an unsigned int.
+              const std::string &groups = args.front();
+              if (groups.empty() || groups.size() > 9 ||
+                  groups.find_first_not_of("0123456789") !=
+                    std::string::npos ||
+                  std::stoul(groups) == 0)
+                {
+                  std::cerr << "Error: flag '-g' must be followed by a "
+                            << "positive number of groups." << std::endl;
+                  exit(1);
+                }
+
+              n_groups = std::stoul(groups);
               args.pop_front();
             }
         }
@@ -43,6 +78,13 @@ main(int argc, char *argv[])
           exit(1);
         }
     } // end while
+
+  if (input_files.empty())
+    {
+      std::cerr << "Error: no parameter file given." << std::endl;
+      exit(1);
+    }
+
   try
     {
       using namespace dealii;
@@ -86,22 +128,18 @@ main(int argc, char *argv[])
                     << std::endl;
         }
 
-      const Dimension dimension(input_file);
-      const int       dim = dimension.dim;
-
-      switch (dim)
+      if (input_files.size() == 1)
         {
-          case 2:
-            run_2d_problem(input_file);
-            break;
-
-          case 3:
-            run_3d_problem(input_file);
-            break;
+          // The parameter file is read once on rank 0 and shared with all
+          // other ranks.
+          const ParameterFile parameter_file(input_files[0], MPI_COMM_WORLD);
 
-          default:
-            std::cout << "The dimension must be 2 or 3." << std::endl;
-            exit(1);
+          run_problem(parameter_file);
+        }
+      else
+        {
+          run_problems(input_files,
+                       (n_groups > 0 ? n_groups : input_files.size()));
         }
     }
   catch (std::exception &exc)
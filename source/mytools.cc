@@ -3,6 +3,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <iostream>
 
 #include "mytools.tpp"
@@ -29,6 +30,48 @@ namespace MyTools
   template const std::vector<unsigned int>
   get_repetitions(const Point<3> &p1, const Point<3> &p2);
 
+  template unsigned int
+  get_lattice_index(const Point<2>    &p,
+                    const Point<2>    &p1,
+                    const Point<2>    &p2,
+                    const unsigned int n_intervals);
+
+  template unsigned int
+  get_lattice_index(const Point<3>    &p,
+                    const Point<3>    &p1,
+                    const Point<3>    &p2,
+                    const unsigned int n_intervals);
+
+  template unsigned int
+  get_lattice_index(const Point<2>                  &p,
+                    const Point<2>                  &p1,
+                    const Point<2>                  &p2,
+                    const std::vector<unsigned int> &n_intervals);
+
+  template unsigned int
+  get_lattice_index(const Point<3>                  &p,
+                    const Point<3>                  &p1,
+                    const Point<3>                  &p2,
+                    const std::vector<unsigned int> &n_intervals);
+
+  template std::vector<std::pair<double, double>>
+  get_min_max_on_lattice(const std::vector<const Function<2> *> &functions,
+                         const Point<2>                         &p1,
+                         const Point<2>                         &p2,
+                         const unsigned int                      n_intervals);
+
+  template std::vector<std::pair<double, double>>
+  get_min_max_on_lattice(const std::vector<const Function<3> *> &functions,
+                         const Point<3>                         &p1,
+                         const Point<3>                         &p2,
+                         const unsigned int                      n_intervals);
+
+  template std::vector<double>
+  get_rigid_body_modes(const DoFHandler<2> &dof_handler);
+
+  template std::vector<double>
+  get_rigid_body_modes(const DoFHandler<3> &dof_handler);
+
   void
   create_data_directory(const char *dir_name)
   {
@@ -47,6 +90,264 @@ namespace MyTools
   }
 
 
+  SharedArray::SharedArray()
+    : data()
+    , n_values(0)
+    , shared(false)
+    , owner(false)
+    , window(MPI_WIN_NULL)
+    , node_communicator(MPI_COMM_NULL)
+  {}
+
+
+  SharedArray::SharedArray(const std::vector<double> &values,
+                           const MPI_Comm             mpi_communicator,
+                           const bool                 use_shared_memory)
+    : data()
+    , n_values(values.size())
+    , shared(false)
+    , owner(false)
+    , window(MPI_WIN_NULL)
+    , node_communicator(MPI_COMM_NULL)
+  {
+    int mpi_is_initialized = 0;
+    MPI_Initialized(&mpi_is_initialized);
+
+    if (!use_shared_memory || !mpi_is_initialized)
+      {
+        std::shared_ptr<std::vector<double>> local_values =
+          std::make_shared<std::vector<double>>(values);
+
+        // aliasing constructor: the vector owns the memory
+        data =
+          std::shared_ptr<const double>(local_values, local_values->data());
+
+        return;
+      }
+
+    int ierr =
+      MPI_Comm_split_type(mpi_communicator,
+                          MPI_COMM_TYPE_SHARED,
+                          Utilities::MPI::this_mpi_process(mpi_communicator),
+                          MPI_INFO_NULL,
+                          &node_communicator);
+    AssertThrowMPI(ierr);
+
+    const unsigned int node_rank =
+      Utilities::MPI::this_mpi_process(node_communicator);
+
+    // Only the first rank on a node allocates memory.
+    const MPI_Aint local_size =
+      (node_rank == 0 ? n_values * sizeof(double) : 0);
+
+    double *base_ptr = nullptr;
+    ierr = MPI_Win_allocate_shared(local_size,
+                                   sizeof(double),
+                                   MPI_INFO_NULL,
+                                   node_communicator,
+                                   &base_ptr,
+                                   &window);
+    AssertThrowMPI(ierr);
+
+    if (node_rank != 0)
+      {
+        MPI_Aint size;
+        int      disp_unit;
+        ierr = MPI_Win_shared_query(window, 0, &size, &disp_unit, &base_ptr);
+        AssertThrowMPI(ierr);
+      }
+
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window);
+    if (node_rank == 0)
+      std::copy(values.begin(), values.end(), base_ptr);
+    MPI_Win_sync(window);
+    MPI_Barrier(node_communicator);
+    MPI_Win_sync(window);
+    MPI_Win_unlock_all(window);
+
+    // The window is released by free(), not by the last view.
+    data   = std::shared_ptr<const double>(base_ptr, [](const double *) {});
+    shared = true;
+    owner  = true;
+  }
+
+
+  SharedArray::SharedArray(const SharedArray &other)
+    : data(other.data)
+    , n_values(other.n_values)
+    , shared(other.shared)
+    , owner(false)
+    , window(MPI_WIN_NULL)
+    , node_communicator(MPI_COMM_NULL)
+  {}
+
+
+  SharedArray::SharedArray(SharedArray &&other) noexcept
+    : data(std::move(other.data))
+    , n_values(other.n_values)
+    , shared(other.shared)
+    , owner(other.owner)
+    , window(other.window)
+    , node_communicator(other.node_communicator)
+  {
+    other.owner             = false;
+    other.window            = MPI_WIN_NULL;
+    other.node_communicator = MPI_COMM_NULL;
+  }
+
+
+  SharedArray &
+  SharedArray::operator=(const SharedArray &other)
+  {
+    Assert(!owner,
+           ExcMessage("The shared memory window must be freed first."));
+
+    if (this != &other)
+      {
+        data     = other.data;
+        n_values = other.n_values;
+        shared   = other.shared;
+      }
+
+    return *this;
+  }
+
+
+  SharedArray &
+  SharedArray::operator=(SharedArray &&other)
+  {
+    Assert(!owner,
+           ExcMessage("The shared memory window must be freed first."));
+
+    if (this != &other)
+      {
+        data              = std::move(other.data);
+        n_values          = other.n_values;
+        shared            = other.shared;
+        owner             = other.owner;
+        window            = other.window;
+        node_communicator = other.node_communicator;
+
+        other.owner             = false;
+        other.window            = MPI_WIN_NULL;
+        other.node_communicator = MPI_COMM_NULL;
+      }
+
+    return *this;
+  }
+
+
+  void
+  SharedArray::free()
+  {
+    if (!owner)
+      return;
+
+    data.reset();
+    n_values = 0;
+    shared   = false;
+
+    int ierr = MPI_Win_free(&window);
+    AssertThrowMPI(ierr);
+    ierr = MPI_Comm_free(&node_communicator);
+    AssertThrowMPI(ierr);
+
+    owner = false;
+  }
+
+
+  const double &
+  SharedArray::operator[](const std::size_t i) const
+  {
+    AssertIndexRange(i, n_values);
+
+    return data.get()[i];
+  }
+
+
+  std::size_t
+  SharedArray::size() const
+  {
+    return n_values;
+  }
+
+
+  bool
+  SharedArray::is_shared() const
+  {
+    return shared;
+  }
+
+
+  RunningStatistics::RunningStatistics()
+    : n(0)
+    , mean_value(0.)
+    , sum_of_squares(0.)
+  {}
+
+
+  RunningStatistics::RunningStatistics(const std::vector<double> &state)
+    : n(static_cast<unsigned long int>(state.at(0)))
+    , mean_value(state.at(1))
+    , sum_of_squares(state.at(2))
+  {}
+
+
+  void
+  RunningStatistics::add(const double value)
+  {
+    ++n;
+    const double delta = value - mean_value;
+    mean_value += delta / n;
+    sum_of_squares += delta * (value - mean_value);
+  }
+
+
+  void
+  RunningStatistics::merge(const RunningStatistics &other)
+  {
+    if (other.n == 0)
+      return;
+
+    const unsigned long int n_total = n + other.n;
+    const double            delta   = other.mean_value - mean_value;
+
+    mean_value += delta * other.n / n_total;
+    sum_of_squares +=
+      other.sum_of_squares +
+      delta * delta * static_cast<double>(n) * other.n / n_total;
+    n = n_total;
+  }
+
+
+  unsigned long int
+  RunningStatistics::n_values() const
+  {
+    return n;
+  }
+
+
+  double
+  RunningStatistics::mean() const
+  {
+    return mean_value;
+  }
+
+
+  double
+  RunningStatistics::variance() const
+  {
+    return (n > 1 ? sum_of_squares / (n - 1) : 0.);
+  }
+
+
+  std::vector<double>
+  RunningStatistics::get_state() const
+  {
+    return {static_cast<double>(n), mean_value, sum_of_squares};
+  }
+
+
   // RandomNumberUInt::RandomNumberUInt(const unsigned int b,
   //                                    const bool same_on_all_ranks = true)
   //   : a(0)
@@ -9,29 +9,101 @@ namespace Elasticity
 
   using namespace dealii;
 
-  Dimension::Dimension(const std::string &parameter_filename)
+  ParameterFile::ParameterFile(const std::string &parameter_filename,
+                               const MPI_Comm     mpi_communicator,
+                               const std::string &output_directory)
+    : filename(parameter_filename)
+    , output_directory(output_directory)
+    , content()
   {
-    ParameterHandler prm;
-
-    declare_parameters(prm);
-
-    std::ifstream parameter_file(parameter_filename);
-    if (!parameter_file)
+    // Only the root rank accesses the file system.
+    int file_found = 1;
+    if (Utilities::MPI::this_mpi_process(mpi_communicator) == 0)
       {
-        parameter_file.close();
-        std::ofstream parameter_out(parameter_filename);
-        prm.print_parameters(parameter_out, ParameterHandler::Text);
-        AssertThrow(
-          false,
-          ExcMessage(
-            "Input parameter file <" + parameter_filename +
-            "> not found. Creating a template file of the same name."));
+        std::ifstream parameter_stream(parameter_filename);
+        if (parameter_stream)
+          {
+            std::stringstream buffer;
+            buffer << parameter_stream.rdbuf();
+            content = buffer.str();
+          }
+        else
+          {
+            file_found = 0;
+
+            ParameterHandler prm;
+            declare_parameters(prm);
+
+            std::ofstream parameter_out(parameter_filename);
+            prm.print_parameters(parameter_out, ParameterHandler::Text);
+          }
       }
 
-    prm.parse_input(parameter_file,
-                    /* filename = */ "generated_parameter.in",
+    int ierr = MPI_Bcast(&file_found, 1, MPI_INT, 0, mpi_communicator);
+    AssertThrowMPI(ierr);
+
+    AssertThrow(file_found,
+                ExcMessage(
+                  "Input parameter file <" + parameter_filename +
+                  "> not found. Creating a template file of the same name."));
+
+    unsigned long long int content_size = content.size();
+    ierr =
+      MPI_Bcast(&content_size, 1, MPI_UNSIGNED_LONG_LONG, 0, mpi_communicator);
+    AssertThrowMPI(ierr);
+
+    content.resize(content_size);
+    ierr = MPI_Bcast(&content[0], content_size, MPI_CHAR, 0, mpi_communicator);
+    AssertThrowMPI(ierr);
+  }
+
+
+  void
+  ParameterFile::declare_parameters(ParameterHandler &prm)
+  {
+    Dimension::declare_parameters(prm);
+    GlobalParameters<2>::declare_parameters(prm);
+    GlobalParameters<3>::declare_parameters(prm);
+    ParametersStd::declare_parameters(prm);
+    ParametersMs::declare_parameters(prm);
+    ParametersBasis::declare_parameters(prm);
+    ParametersEnsemble::declare_parameters(prm);
+    ParametersRun::declare_parameters(prm);
+  }
+
+
+  void
+  ParameterFile::parse(ParameterHandler &prm) const
+  {
+    std::istringstream parameter_stream(content);
+
+    prm.parse_input(parameter_stream,
+                    /* filename = */ filename,
                     /* last_line = */ "",
                     /* skip_undefined = */ true);
+  }
+
+
+  const std::string &
+  ParameterFile::get_filename() const
+  {
+    return filename;
+  }
+
+
+  const std::string &
+  ParameterFile::get_output_directory() const
+  {
+    return output_directory;
+  }
+
+
+  Dimension::Dimension(const ParameterFile &parameter_file)
+  {
+    ParameterHandler prm;
+
+    declare_parameters(prm);
+    parameter_file.parse(prm);
     parse_parameters(prm);
   }
 
@@ -58,29 +130,108 @@ namespace Elasticity
   }
 
 
-  ParametersStd::ParametersStd(const std::string &parameter_filename)
+  void
+  ParametersSolver::declare_parameters(ParameterHandler &prm)
   {
-    ParameterHandler prm;
+    prm.enter_subsection("Linear solver");
+    {
+      prm.declare_entry("direct solver",
+                        "KLU",
+                        Patterns::Selection("KLU|MUMPS|SuperLU_dist"),
+                        "Direct solver of Amesos.");
+      prm.declare_entry("preconditioner",
+                        "AMG",
+                        Patterns::Selection(
+                          "AMG|Chebyshev|ILU|block Jacobi|SSOR"),
+                        "Preconditioner of the CG method.");
+      prm.declare_entry("AMG package",
+                        "ML",
+                        Patterns::Selection("ML|MueLu"),
+                        "Trilinos package of the AMG preconditioner.");
+      prm.declare_entry("AMG smoother",
+                        "ML symmetric Gauss-Seidel",
+                        Patterns::Anything(),
+                        "Smoother of the AMG preconditioner, e.g. "
+                        "Chebyshev, Jacobi or ML symmetric Gauss-Seidel.");
+      prm.declare_entry("AMG smoother sweeps",
+                        "2",
+                        Patterns::Integer(1),
+                        "Number of smoother sweeps of the AMG "
+                        "preconditioner.");
+      prm.declare_entry("AMG aggregation threshold",
+                        "0.002",
+                        Patterns::Double(0),
+                        "Aggregation threshold of the AMG preconditioner.");
+      prm.declare_entry("AMG rigid body modes",
+                        "true",
+                        Patterns::Bool(),
+                        "Choose whether the near null space of ML contains "
+                        "the rotations besides the translations.");
+      prm.declare_entry("Chebyshev degree",
+                        "4",
+                        Patterns::Integer(1),
+                        "Degree of the Chebyshev preconditioner.");
+      prm.declare_entry("ILU fill",
+                        "0",
+                        Patterns::Integer(0),
+                        "Fill-in level of the ILU preconditioner.");
+      prm.declare_entry("relaxation",
+                        "1.0",
+                        Patterns::Double(0, 2),
+                        "Relaxation parameter of the block Jacobi and SSOR "
+                        "preconditioners.");
+      prm.declare_entry("warm start",
+                        "true",
+                        Patterns::Bool(),
+                        "Choose whether the iterative solver starts from the "
+                        "last solution of the same load case, e.g. of the "
+                        "last material or the last cycle.");
+      prm.declare_entry("mixed precision",
+                        "false",
+                        Patterns::Bool(),
+                        "Choose whether the CG method runs in single "
+                        "precision with a Chebyshev preconditioner inside "
+                        "an iterative refinement in double precision.");
+    }
+    prm.leave_subsection();
+  }
 
-    declare_parameters(prm);
 
-    std::ifstream parameter_file(parameter_filename);
-    if (!parameter_file)
-      {
-        parameter_file.close();
-        std::ofstream parameter_out(parameter_filename);
-        prm.print_parameters(parameter_out, ParameterHandler::Text);
-        AssertThrow(
-          false,
-          ExcMessage(
-            "Input parameter file <" + parameter_filename +
-            "> not found. Creating a template file of the same name."));
-      }
+  void
+  ParametersSolver::parse_parameters(ParameterHandler &prm)
+  {
+    prm.enter_subsection("Linear solver");
+    {
+      const std::string direct_solver_name = prm.get("direct solver");
+      if (direct_solver_name == "KLU")
+        direct_solver_type = "Amesos_Klu";
+      else if (direct_solver_name == "MUMPS")
+        direct_solver_type = "Amesos_Mumps";
+      else
+        direct_solver_type = "Amesos_Superludist";
+
+      preconditioner        = prm.get("preconditioner");
+      amg_package           = prm.get("AMG package");
+      smoother_type         = prm.get("AMG smoother");
+      smoother_sweeps       = prm.get_integer("AMG smoother sweeps");
+      aggregation_threshold = prm.get_double("AMG aggregation threshold");
+      rigid_body_modes      = prm.get_bool("AMG rigid body modes");
+      chebyshev_degree      = prm.get_integer("Chebyshev degree");
+      ilu_fill              = prm.get_integer("ILU fill");
+      relaxation            = prm.get_double("relaxation");
+      warm_start            = prm.get_bool("warm start");
+      mixed_precision       = prm.get_bool("mixed precision");
+    }
+    prm.leave_subsection();
+  }
 
-    prm.parse_input(parameter_file,
-                    /* filename = */ "generated_parameter.in",
-                    /* last_line = */ "",
-                    /* skip_undefined = */ true);
+
+  ParametersStd::ParametersStd(const ParameterFile &parameter_file)
+  {
+    ParameterHandler prm;
+
+    declare_parameters(prm);
+    parameter_file.parse(prm);
     parse_parameters(prm);
   }
 
@@ -100,9 +251,17 @@ namespace Elasticity
                           "true",
                           Patterns::Bool(),
                           "Choose whether to use a direct solver.");
+        prm.declare_entry(
+          "use two-level Schwarz preconditioner",
+          "false",
+          Patterns::Bool(),
+          "Choose whether to precondition the iterative solver with the "
+          "basis functions of the MsFEM as coarse space instead of AMG.");
       }
       prm.leave_subsection();
 
+      ParametersSolver::declare_parameters(prm);
+
       prm.enter_subsection("Mesh");
       {
         prm.declare_entry("refinements",
@@ -129,9 +288,14 @@ namespace Elasticity
       {
         verbose       = prm.get_bool("verbose");
         direct_solver = prm.get_bool("use direct solver");
+        two_level_schwarz =
+          prm.get_bool("use two-level Schwarz preconditioner");
       }
       prm.leave_subsection();
 
+      linear_solver.parse_parameters(prm);
+      linear_solver.direct_solver = direct_solver;
+
       prm.enter_subsection("Mesh");
       {
         n_refine = prm.get_integer("refinements");
@@ -143,29 +307,12 @@ namespace Elasticity
   }
 
 
-  ParametersMs::ParametersMs(const std::string &parameter_filename)
+  ParametersMs::ParametersMs(const ParameterFile &parameter_file)
   {
     ParameterHandler prm;
 
     declare_parameters(prm);
-
-    std::ifstream parameter_file(parameter_filename);
-    if (!parameter_file)
-      {
-        parameter_file.close();
-        std::ofstream parameter_out(parameter_filename);
-        prm.print_parameters(parameter_out, ParameterHandler::Text);
-        AssertThrow(
-          false,
-          ExcMessage(
-            "Input parameter file <" + parameter_filename +
-            "> not found. Creating a template file of the same name."));
-      }
-
-    prm.parse_input(parameter_file,
-                    /* filename = */ "generated_parameter.in",
-                    /* last_line = */ "",
-                    /* skip_undefined = */ true);
+    parameter_file.parse(prm);
     parse_parameters(prm);
   }
 
@@ -187,9 +334,28 @@ namespace Elasticity
                             "true",
                             Patterns::Bool(),
                             "Choose whether to use a direct solver.");
+          prm.declare_entry("weighted partitioning",
+                            "false",
+                            Patterns::Bool(),
+                            "Choose whether to weight the coarse cells with "
+                            "the cost of their basis functions.");
+          prm.declare_entry("a priori weights",
+                            "true",
+                            Patterns::Bool(),
+                            "Choose whether to weight the first partition "
+                            "with the material contrast.");
         }
         prm.leave_subsection();
 
+        prm.declare_entry("basis scheduling",
+                          "owner",
+                          Patterns::Selection(
+                            "owner|work stealing|all processors"),
+                          "Which processors compute the basis functions of a "
+                          "coarse cell.");
+
+        ParametersSolver::declare_parameters(prm);
+
         prm.enter_subsection("Mesh");
         {
           prm.declare_entry("refinements",
@@ -218,11 +384,18 @@ namespace Elasticity
       {
         prm.enter_subsection("Bools");
         {
-          verbose       = prm.get_bool("verbose");
-          direct_solver = prm.get_bool("use direct solver");
+          verbose               = prm.get_bool("verbose");
+          direct_solver         = prm.get_bool("use direct solver");
+          weighted_partitioning = prm.get_bool("weighted partitioning");
+          a_priori_weights      = prm.get_bool("a priori weights");
         }
         prm.leave_subsection();
 
+        basis_scheduling = prm.get("basis scheduling");
+
+        linear_solver.parse_parameters(prm);
+        linear_solver.direct_solver = direct_solver;
+
         prm.enter_subsection("Mesh");
         {
           n_refine = prm.get_integer("refinements");
@@ -236,29 +409,12 @@ namespace Elasticity
   }
 
 
-  ParametersBasis::ParametersBasis(const std::string &parameter_filename)
+  ParametersBasis::ParametersBasis(const ParameterFile &parameter_file)
   {
     ParameterHandler prm;
 
     declare_parameters(prm);
-
-    std::ifstream parameter_file(parameter_filename);
-    if (!parameter_file)
-      {
-        parameter_file.close();
-        std::ofstream parameter_out(parameter_filename);
-        prm.print_parameters(parameter_out, ParameterHandler::Text);
-        AssertThrow(
-          false,
-          ExcMessage(
-            "Input parameter file <" + parameter_filename +
-            "> not found. Creating a template file of the same name."));
-      }
-
-    prm.parse_input(parameter_file,
-                    /* filename = */ "generated_parameter.in",
-                    /* last_line = */ "",
-                    /* skip_undefined = */ true);
+    parameter_file.parse(prm);
     parse_parameters(prm);
   }
 
@@ -285,6 +441,13 @@ namespace Elasticity
             "true",
             Patterns::Bool(),
             "Choose whether to prevent the output on the fine scale.");
+          prm.declare_entry("single precision",
+                            "false",
+                            Patterns::Bool(),
+                            "Choose whether the iterative solver runs in "
+                            "single precision. Only applies to the CG "
+                            "solver, the direct solver stays in double "
+                            "precision.");
         }
         prm.leave_subsection();
 
@@ -294,8 +457,75 @@ namespace Elasticity
                             "3",
                             Patterns::Integer(1, 10),
                             "Number of initial mesh refinements.");
+          prm.declare_entry("levels",
+                            "1",
+                            Patterns::Integer(1, 10),
+                            "Number of levels of the MsFEM in a coarse "
+                            "cell.");
+        }
+        prm.leave_subsection();
+
+        prm.enter_subsection("Adaptivity");
+        {
+          prm.declare_entry("refinement",
+                            "global",
+                            Patterns::Selection(
+                              "global|material|kelly|anisotropic"),
+                            "How the fine mesh of a cell is refined.");
+          prm.declare_entry("dof budget",
+                            "0",
+                            Patterns::Integer(0),
+                            "Maximal number of fine dofs of a cell with "
+                            "adaptive refinement. Zero disables it.");
+          prm.declare_entry("refinement fraction",
+                            "0.3",
+                            Patterns::Double(0, 1),
+                            "Fraction of the cells that the Kelly "
+                            "refinement refines in each step.");
+        }
+        prm.leave_subsection();
+
+        prm.enter_subsection("Solver");
+        {
+          prm.declare_entry("tolerance policy",
+                            "fixed",
+                            Patterns::Selection("fixed|coarse error"),
+                            "How the tolerance of the iterative solver is "
+                            "chosen.");
+          prm.declare_entry("tolerance",
+                            "1e-8",
+                            Patterns::Double(0),
+                            "Relative tolerance of the fixed policy.");
+          prm.declare_entry("safety factor",
+                            "0.1",
+                            Patterns::Double(0),
+                            "Safety factor of the coarse error policy.");
+          prm.declare_entry("reduction",
+                            "0",
+                            Patterns::Double(0, 1),
+                            "Reduction of the initial residual that also "
+                            "stops the solver. Zero disables it.");
         }
         prm.leave_subsection();
+
+        prm.enter_subsection("Distributed");
+        {
+          prm.declare_entry("dof threshold",
+                            "0",
+                            Patterns::Integer(0),
+                            "Number of fine dofs of a cell above which a "
+                            "group of processors computes its basis "
+                            "functions. Zero disables it. Requires one "
+                            "level, global refinement, double precision "
+                            "and the fixed tolerance policy.");
+          prm.declare_entry("processes per cell",
+                            "4",
+                            Patterns::Integer(1),
+                            "Number of processors in a group.");
+        }
+        prm.leave_subsection();
+
+        ParametersSolver::declare_parameters(prm);
       }
       prm.leave_subsection();
     }
@@ -312,20 +542,175 @@ namespace Elasticity
       {
         prm.enter_subsection("Bools");
         {
-          verbose        = prm.get_bool("verbose");
-          direct_solver  = prm.get_bool("use direct solver");
-          prevent_output = prm.get_bool("prevent output");
+          verbose          = prm.get_bool("verbose");
+          direct_solver    = prm.get_bool("use direct solver");
+          prevent_output   = prm.get_bool("prevent output");
+          single_precision = prm.get_bool("single precision");
         }
         prm.leave_subsection();
 
         prm.enter_subsection("Mesh");
         {
           n_refine = prm.get_integer("refinements");
+          n_levels = prm.get_integer("levels");
+        }
+        prm.leave_subsection();
+
+        prm.enter_subsection("Adaptivity");
+        {
+          refinement          = prm.get("refinement");
+          dof_budget          = prm.get_integer("dof budget");
+          refinement_fraction = prm.get_double("refinement fraction");
         }
         prm.leave_subsection();
+
+        prm.enter_subsection("Solver");
+        {
+          tolerance_policy = prm.get("tolerance policy");
+          solver_tolerance = prm.get_double("tolerance");
+          safety_factor    = prm.get_double("safety factor");
+          solver_reduction = prm.get_double("reduction");
+        }
+        prm.leave_subsection();
+
+        prm.enter_subsection("Distributed");
+        {
+          distributed_threshold = prm.get_integer("dof threshold");
+          processes_per_cell    = prm.get_integer("processes per cell");
+        }
+        prm.leave_subsection();
+
+        linear_solver.parse_parameters(prm);
+        linear_solver.direct_solver = direct_solver;
       }
       prm.leave_subsection();
     }
     prm.leave_subsection();
   }
+
+
+  ParametersEnsemble::ParametersEnsemble(const ParameterFile &parameter_file)
+  {
+    ParameterHandler prm;
+
+    declare_parameters(prm);
+    parameter_file.parse(prm);
+    parse_parameters(prm);
+  }
+
+
+  void
+  ParametersEnsemble::declare_parameters(ParameterHandler &prm)
+  {
+    prm.enter_subsection("Ensemble parameters");
+    {
+      prm.declare_entry("run ensemble",
+                        "false",
+                        Patterns::Bool(),
+                        "Choose whether to compute an ensemble of "
+                        "material samples.");
+      prm.declare_entry("verbose",
+                        "true",
+                        Patterns::Bool(),
+                        "Choose whether to verbose.");
+      prm.declare_entry("samples",
+                        "10",
+                        Patterns::Integer(1),
+                        "Number of material samples.");
+      prm.declare_entry("first seed",
+                        "1",
+                        Patterns::Integer(1),
+                        "Seed of the first material sample.");
+      prm.declare_entry("groups",
+                        "1",
+                        Patterns::Integer(1),
+                        "Number of groups of MPI ranks that compute "
+                        "the samples independently.");
+    }
+    prm.leave_subsection();
+  }
+
+
+  void
+  ParametersEnsemble::parse_parameters(ParameterHandler &prm)
+  {
+    prm.enter_subsection("Ensemble parameters");
+    {
+      run_ensemble = prm.get_bool("run ensemble");
+      verbose      = prm.get_bool("verbose");
+      n_samples    = prm.get_integer("samples");
+      first_seed   = prm.get_integer("first seed");
+      n_groups     = prm.get_integer("groups");
+    }
+    prm.leave_subsection();
+  }
+
+
+  ParametersRun::ParametersRun(const ParameterFile &parameter_file)
+  {
+    ParameterHandler prm;
+
+    declare_parameters(prm);
+    parameter_file.parse(prm);
+    parse_parameters(prm);
+  }
+
+
+  void
+  ParametersRun::declare_parameters(ParameterHandler &prm)
+  {
+    prm.enter_subsection("Run parameters");
+    {
+      prm.declare_entry("standard FEM",
+                        "true",
+                        Patterns::Bool(),
+                        "Choose whether to run the standard FEM.");
+      prm.declare_entry("MsFEM",
+                        "true",
+                        Patterns::Bool(),
+                        "Choose whether to run the MsFEM.");
+      prm.declare_entry("output",
+                        "true",
+                        Patterns::Bool(),
+                        "Choose whether to write the solutions to vtu files.");
+      prm.declare_entry("comparison",
+                        "false",
+                        Patterns::Bool(),
+                        "Choose whether to compute the difference of the "
+                        "MsFEM and the standard FEM solutions.");
+      prm.declare_entry("concurrent",
+                        "false",
+                        Patterns::Bool(),
+                        "Choose whether to run the standard FEM and the "
+                        "MsFEM at the same time on disjoint groups of ranks.");
+      prm.declare_entry("std rank fraction",
+                        "0",
+                        Patterns::Double(0, 1),
+                        "Fraction of the ranks for the standard FEM in "
+                        "concurrent runs. Zero means that it is estimated "
+                        "from the number of degrees of freedom.");
+      prm.declare_entry("verbose",
+                        "true",
+                        Patterns::Bool(),
+                        "Choose whether to verbose.");
+    }
+    prm.leave_subsection();
+  }
+
+
+  void
+  ParametersRun::parse_parameters(ParameterHandler &prm)
+  {
+    prm.enter_subsection("Run parameters");
+    {
+      run_std           = prm.get_bool("standard FEM");
+      run_ms            = prm.get_bool("MsFEM");
+      write_output      = prm.get_bool("output");
+      compare           = prm.get_bool("comparison");
+      concurrent        = prm.get_bool("concurrent");
+      std_rank_fraction = prm.get_double("std rank fraction");
+      verbose           = prm.get_bool("verbose");
+    }
+    prm.leave_subsection();
+  }
 } // namespace Elasticity
\ No newline at end of file
@@ -3,41 +3,528 @@
 
 namespace Elasticity
 {
-  void
-  run_2d_problem(const std::string &input_file)
+  namespace
   {
-    GlobalParameters<2> global_parameters(input_file);
-
+    /**
+     * @brief Runs an ensemble of material samples with ElaStd.
+     *
+     * @tparam dim Space dimension
+     * @param parameter_file Content of the parameter file
+     * @param global_parameters Parameters of the unperturbed material
+     * @param mpi_communicator Communicator of all ranks of the ensemble
+     *
+     * mpi_communicator is split into ParametersEnsemble::n_groups
+     * groups of consecutive ranks. The samples are distributed
+     * round-robin over the groups and the statistics of all groups are
+     * merged on the first rank and written to ensemble_statistics.csv in
+     * the output directory.
+     */
+    template <int dim>
+    void
+    run_ensemble(
+      const ParameterFile &                               parameter_file,
+      const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+      const MPI_Comm                                      mpi_communicator)
     {
-      ParametersStd parameters_std(input_file);
-      ElaStd<2>     ela_std(global_parameters, parameters_std);
-      ela_std.run();
+      const ParametersEnsemble parameters_ensemble(parameter_file);
+      const std::string &      output_directory =
+        parameter_file.get_output_directory();
+
+      const unsigned int n_ranks =
+        Utilities::MPI::n_mpi_processes(mpi_communicator);
+      const unsigned int rank =
+        Utilities::MPI::this_mpi_process(mpi_communicator);
+      const unsigned int n_groups =
+        std::min(parameters_ensemble.n_groups, n_ranks);
+      const unsigned int group = rank * n_groups / n_ranks;
+
+      MPI_Comm group_communicator;
+      MPI_Comm_split(mpi_communicator, group, rank, &group_communicator);
+      const bool is_group_leader =
+        (Utilities::MPI::this_mpi_process(group_communicator) == 0);
+
+      std::vector<unsigned int> seeds;
+      for (unsigned int sample = group; sample < parameters_ensemble.n_samples;
+           sample += n_groups)
+        {
+          seeds.push_back(parameters_ensemble.first_seed + sample);
+        }
+
+      std::vector<MyTools::RunningStatistics> statistics;
+      {
+        ParametersStd parameters_std(parameter_file);
+        parameters_std.verbose =
+          parameters_std.verbose && parameters_ensemble.verbose;
+
+        ElaStd<dim> ela_std(global_parameters,
+                            parameters_std,
+                            group_communicator);
+        statistics = ela_std.run_ensemble(
+          seeds,
+          output_directory + "ensemble_samples-" +
+            Utilities::int_to_string(group, 3) + ".csv");
+      }
+
+      MPI_Comm_free(&group_communicator);
+
+      // Only the group leaders contribute their statistics.
+      std::vector<double> state;
+      if (is_group_leader)
+        {
+          for (const MyTools::RunningStatistics &quantity : statistics)
+            {
+              const std::vector<double> quantity_state = quantity.get_state();
+              state.insert(state.end(),
+                           quantity_state.begin(),
+                           quantity_state.end());
+            }
+        }
+
+      const std::vector<std::vector<double>> all_states =
+        Utilities::MPI::gather(mpi_communicator, state, 0);
+
+      if (rank == 0)
+        {
+          const std::vector<std::string> quantity_names =
+            ElaStd<dim>::get_ensemble_quantity_names();
+          std::vector<MyTools::RunningStatistics> merged_statistics(
+            quantity_names.size());
+
+          for (const std::vector<double> &group_state : all_states)
+            {
+              if (group_state.empty())
+                continue;
+
+              const unsigned int state_size =
+                group_state.size() / quantity_names.size();
+              for (unsigned int q = 0; q < quantity_names.size(); ++q)
+                {
+                  merged_statistics[q].merge(MyTools::RunningStatistics(
+                    std::vector<double>(group_state.begin() + q * state_size,
+                                        group_state.begin() +
+                                          (q + 1) * state_size)));
+                }
+            }
+
+          std::ofstream output(output_directory + "ensemble_statistics.csv");
+          output << "quantity,samples,mean,variance,standard deviation"
+                 << std::endl;
+          for (unsigned int q = 0; q < quantity_names.size(); ++q)
+            {
+              output << quantity_names[q] << ","
+                     << merged_statistics[q].n_values() << ","
+                     << merged_statistics[q].mean() << ","
+                     << merged_statistics[q].variance() << ","
+                     << std::sqrt(merged_statistics[q].variance())
+                     << std::endl;
+            }
+
+          if (parameters_ensemble.verbose)
+            {
+              std::cout << "Ensemble statistics written to "
+                        << output_directory << "ensemble_statistics.csv"
+                        << std::endl;
+            }
+        }
     }
 
+
+    /**
+     * @brief Estimates the fraction of the work of ElaStd.
+     *
+     * @tparam dim Space dimension
+     * @param global_parameters Parameters that many classes need
+     * @param parameters_std Parameters of ElaStd
+     * @param parameters_ms Parameters of ElaMs
+     * @param parameters_basis Parameters of ElaBasis
+     * @return double Fraction of the work of ElaStd in (0, 1)
+     *
+     * The work of a method is estimated by the number of degrees of
+     * freedom times the number of right-hand sides that are solved with
+     * them, summed over all cycles. ElaMs solves on the coarse mesh and,
+     * in each coarse cell, one fine-scale problem per local degree of
+     * freedom.
+     */
+    template <int dim>
+    double
+    estimate_std_work_fraction(const GlobalParameters<dim> &global_parameters,
+                               const ParametersStd &        parameters_std,
+                               const ParametersMs &         parameters_ms,
+                               const ParametersBasis &      parameters_basis)
     {
-      ParametersMs    parameters_ms(input_file);
-      ParametersBasis parameters_basis(input_file);
-      ElaMs<2> ela_ms(global_parameters, parameters_ms, parameters_basis);
-      ela_ms.run();
+      const std::vector<unsigned int> repetitions =
+        MyTools::get_repetitions(global_parameters.init_p1,
+                                 global_parameters.init_p2);
+
+      double n_initial_cells = 1;
+      for (const unsigned int n : repetitions)
+        n_initial_cells *= n;
+
+      double std_work = 0;
+      for (unsigned int cycle = 0; cycle < parameters_std.n_cycles; ++cycle)
+        std_work += dim * n_initial_cells *
+                    std::pow(2., dim * (parameters_std.n_refine + cycle));
+
+      const double n_coarse_cells =
+        n_initial_cells * std::pow(2., dim * parameters_ms.n_refine);
+      const double n_local_dofs = dim * GeometryInfo<dim>::vertices_per_cell;
+
+      double ms_work = 0;
+      for (unsigned int cycle = 0; cycle < parameters_ms.n_cycles; ++cycle)
+        ms_work +=
+          dim * n_coarse_cells *
+          (1 + n_local_dofs *
+                 std::pow(2., dim * (parameters_basis.n_refine + cycle)));
+
+      return std_work / (std_work + ms_work);
     }
-  }
 
-  void
-  run_3d_problem(const std::string &input_file)
-  {
-    GlobalParameters<3> global_parameters(input_file);
 
+    /**
+     * @brief Computes the difference of the MsFEM and the standard FEM
+     *        solution.
+     *
+     * @tparam dim Space dimension
+     * @param ela_std Standard FEM after run()
+     * @param ela_ms MsFEM after run() on the same communicator
+     * @param global_parameters Parameters that many classes need
+     * @param output_directory Directory of comparison.csv
+     * @param mpi_communicator Communicator of both methods
+     *
+     * The L2 norm and the energy norm of the difference are integrated
+     * with the quadrature of the fine cells of ElaBasis. The standard FEM
+     * solution is evaluated at these points across the two distributed
+     * meshes with ElaStd::evaluate_solution(). Both methods are compared
+     * for the last material and load case they solved.
+     *
+     * The absolute and relative differences are written to
+     * comparison.csv.
+     */
+    template <int dim>
+    void
+    compare_solutions(const ElaStd<dim> &           ela_std,
+                      const ElaMs<dim> &            ela_ms,
+                      const GlobalParameters<dim> &global_parameters,
+                      const std::string &           output_directory,
+                      const MPI_Comm                mpi_communicator)
     {
-      ParametersStd parameters_std(input_file);
-      ElaStd<3>     ela_std(global_parameters, parameters_std);
-      ela_std.run();
+      std::vector<Point<dim>>     points;
+      std::vector<double>         JxW;
+      std::vector<Tensor<1, dim>> ms_values, std_values;
+      std::vector<Tensor<2, dim>> ms_gradients, std_gradients;
+
+      ela_ms.get_fine_solution_at_quadrature_points(points,
+                                                    JxW,
+                                                    ms_values,
+                                                    ms_gradients);
+      ela_std.evaluate_solution(points, std_values, std_gradients);
+
+      const LameScaling &lame_scaling = global_parameters.material_sweep.back();
+
+      // a(u, u) = (2 mu eps(u), eps(u)) + (lambda div(u), div(u))
+      const auto energy_density = [&](const Tensor<2, dim> &gradient,
+                                      const Point<dim> &    point) {
+        const SymmetricTensor<2, dim> strain = symmetrize(gradient);
+        const double                  lambda =
+          lame_scaling.lambda * global_parameters.lambda.value(point);
+        const double mu = lame_scaling.mu * global_parameters.mu.value(point);
+
+        return 2 * mu * (strain * strain) +
+               lambda * trace(strain) * trace(strain);
+      };
+
+      double l2_difference = 0, energy_difference = 0;
+      double l2_reference = 0, energy_reference = 0;
+      for (unsigned int q = 0; q < points.size(); ++q)
+        {
+          const Tensor<1, dim> difference = ms_values[q] - std_values[q];
+          const Tensor<2, dim> gradient_difference =
+            ms_gradients[q] - std_gradients[q];
+
+          l2_difference += difference.norm_square() * JxW[q];
+          energy_difference +=
+            energy_density(gradient_difference, points[q]) * JxW[q];
+          l2_reference += std_values[q].norm_square() * JxW[q];
+          energy_reference +=
+            energy_density(std_gradients[q], points[q]) * JxW[q];
+        }
+
+      l2_difference =
+        std::sqrt(Utilities::MPI::sum(l2_difference, mpi_communicator));
+      energy_difference =
+        std::sqrt(Utilities::MPI::sum(energy_difference, mpi_communicator));
+      l2_reference =
+        std::sqrt(Utilities::MPI::sum(l2_reference, mpi_communicator));
+      energy_reference =
+        std::sqrt(Utilities::MPI::sum(energy_reference, mpi_communicator));
+
+      if (Utilities::MPI::this_mpi_process(mpi_communicator) == 0)
+        {
+          std::cout << "Difference of the MsFEM and the standard FEM:"
+                    << std::endl
+                    << "   L2 norm:     " << l2_difference << " (relative "
+                    << l2_difference / l2_reference << ")" << std::endl
+                    << "   energy norm: " << energy_difference
+                    << " (relative " << energy_difference / energy_reference
+                    << ")" << std::endl
+                    << std::endl;
+
+          std::ofstream output(output_directory + "comparison.csv");
+          output << "l2 difference,relative l2 difference,"
+                 << "energy difference,relative energy difference"
+                 << std::endl
+                 << l2_difference << "," << l2_difference / l2_reference << ","
+                 << energy_difference << ","
+                 << energy_difference / energy_reference << std::endl;
+        }
     }
 
+
+    /**
+     * @brief Runs the stages of ParametersRun.
+     *
+     * @tparam dim Space dimension
+     * @param parameter_file Content of the parameter file
+     * @param global_parameters Parameters that many classes need
+     * @param mpi_communicator Communicator of all ranks that run the problem
+     *
+     * By default, ElaStd and then ElaMs run on all ranks. Each of them can
+     * be switched off. If both run and ParametersRun::concurrent is true,
+     * the ranks are split into two groups of consecutive ranks instead
+     * and ElaStd and ElaMs run at the same time, each on its own group.
+     *
+     * With ParametersRun::compare, ElaStd is kept until ElaMs has run
+     * and both solutions are compared with compare_solutions().
+     *
+     * With ParametersStd::two_level_schwarz, ElaMs runs first on all ranks
+     * and its basis functions are the coarse space of the preconditioner
+     * of ElaStd.
+     */
+    template <int dim>
+    void
+    run_stages(
+      const ParameterFile &                               parameter_file,
+      const std::shared_ptr<const GlobalParameters<dim>> &global_parameters,
+      const MPI_Comm                                      mpi_communicator)
     {
-      ParametersMs    parameters_ms(input_file);
-      ParametersBasis parameters_basis(input_file);
-      ElaMs<3> ela_ms(global_parameters, parameters_ms, parameters_basis);
-      ela_ms.run();
+      const ParametersRun   parameters_run(parameter_file);
+      const ParametersStd   parameters_std(parameter_file);
+      const ParametersMs    parameters_ms(parameter_file);
+      const ParametersBasis parameters_basis(parameter_file);
+
+      const unsigned int n_ranks =
+        Utilities::MPI::n_mpi_processes(mpi_communicator);
+      const unsigned int rank =
+        Utilities::MPI::this_mpi_process(mpi_communicator);
+
+      AssertThrow(!parameters_run.compare ||
+                    (parameters_run.run_std && parameters_run.run_ms),
+                  ExcMessage("The comparison needs the standard FEM and "
+                             "the MsFEM."));
+
+      // The two-level Schwarz preconditioner of ElaStd needs the basis
+      // functions of ElaMs.
+      const bool ms_first = parameters_std.two_level_schwarz &&
+                            parameters_run.run_std && parameters_run.run_ms;
+
+      // The comparison and the coarse space need both methods on the same
+      // ranks.
+      const bool concurrent =
+        parameters_run.concurrent && !parameters_run.compare && !ms_first &&
+        parameters_run.run_std && parameters_run.run_ms && (n_ranks > 1);
+
+      bool     run_std = parameters_run.run_std;
+      bool     run_ms  = parameters_run.run_ms;
+      MPI_Comm group_communicator = mpi_communicator;
+
+      if (concurrent)
+        {
+          const double std_fraction =
+            (parameters_run.std_rank_fraction > 0 ?
+               parameters_run.std_rank_fraction :
+               estimate_std_work_fraction(*global_parameters,
+                                          parameters_std,
+                                          parameters_ms,
+                                          parameters_basis));
+
+          // Both groups get at least one rank.
+          const unsigned int n_std_ranks = std::max(
+            1u,
+            std::min(n_ranks - 1,
+                     static_cast<unsigned int>(std::round(std_fraction *
+                                                          n_ranks))));
+
+          run_std = (rank < n_std_ranks);
+          run_ms  = !run_std;
+
+          MPI_Comm_split(mpi_communicator,
+                         (run_std ? 0 : 1),
+                         rank,
+                         &group_communicator);
+
+          if (parameters_run.verbose && rank == 0)
+            {
+              std::cout << "Running the standard FEM on " << n_std_ranks
+                        << " and the MsFEM on " << n_ranks - n_std_ranks
+                        << " rank(s) concurrently." << std::endl;
+            }
+        }
+
+      std::unique_ptr<ElaStd<dim>> ela_std;
+      std::unique_ptr<ElaMs<dim>>  ela_ms;
+
+      const auto run_ela_ms = [&]() {
+        ela_ms = std::make_unique<ElaMs<dim>>(global_parameters,
+                                              parameters_ms,
+                                              parameters_basis,
+                                              group_communicator);
+        ela_ms->run(parameters_run.write_output);
+      };
+
+      if (run_ms && ms_first)
+        run_ela_ms();
+
+      if (run_std)
+        {
+          ela_std = std::make_unique<ElaStd<dim>>(global_parameters,
+                                                  parameters_std,
+                                                  group_communicator);
+          if (ms_first)
+            ela_std->set_coarse_space(*ela_ms);
+          ela_std->run(parameters_run.write_output);
+
+          if (!parameters_run.compare)
+            ela_std.reset();
+        }
+
+      if (run_ms && !ms_first)
+        run_ela_ms();
+
+      if (parameters_run.compare)
+        {
+          compare_solutions(*ela_std,
+                            *ela_ms,
+                            *global_parameters,
+                            parameter_file.get_output_directory(),
+                            mpi_communicator);
+        }
+
+      // The solvers still refer to the group communicator, so they are
+      // destroyed before it is freed.
+      ela_ms.reset();
+      ela_std.reset();
+
+      if (concurrent)
+        MPI_Comm_free(&group_communicator);
     }
+  } // namespace
+
+
+  void
+  run_2d_problem(const ParameterFile &parameter_file,
+                 const MPI_Comm       mpi_communicator)
+  {
+    const std::shared_ptr<const GlobalParameters<2>> global_parameters =
+      std::make_shared<const GlobalParameters<2>>(parameter_file,
+                                                  mpi_communicator);
+
+    if (ParametersEnsemble(parameter_file).run_ensemble)
+      {
+        run_ensemble<2>(parameter_file, global_parameters, mpi_communicator);
+        return;
+      }
+
+    run_stages<2>(parameter_file, global_parameters, mpi_communicator);
+  }
+
+  void
+  run_3d_problem(const ParameterFile &parameter_file,
+                 const MPI_Comm       mpi_communicator)
+  {
+    const std::shared_ptr<const GlobalParameters<3>> global_parameters =
+      std::make_shared<const GlobalParameters<3>>(parameter_file,
+                                                  mpi_communicator);
+
+    if (ParametersEnsemble(parameter_file).run_ensemble)
+      {
+        run_ensemble<3>(parameter_file, global_parameters, mpi_communicator);
+        return;
+      }
+
+    run_stages<3>(parameter_file, global_parameters, mpi_communicator);
+  }
+
+  void
+  run_problem(const ParameterFile &parameter_file,
+              const MPI_Comm       mpi_communicator)
+  {
+    const Dimension dimension(parameter_file);
+
+    switch (dimension.dim)
+      {
+        case 2:
+          run_2d_problem(parameter_file, mpi_communicator);
+          break;
+
+        case 3:
+          run_3d_problem(parameter_file, mpi_communicator);
+          break;
+
+        default:
+          AssertThrow(false, ExcMessage("The dimension must be 2 or 3."));
+      }
+  }
+
+  void
+  run_problems(const std::vector<std::string> &parameter_filenames,
+               const unsigned int              n_groups)
+  {
+    const unsigned int n_ranks =
+      Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD);
+    const unsigned int rank = Utilities::MPI::this_mpi_process(MPI_COMM_WORLD);
+    const unsigned int n_used_groups =
+      std::min({n_groups,
+                n_ranks,
+                static_cast<unsigned int>(parameter_filenames.size())});
+    const unsigned int group = rank * n_used_groups / n_ranks;
+
+    // All runs write into subdirectories of the output directory.
+    if (rank == 0)
+      {
+        try
+          {
+            MyTools::create_data_directory("output/");
+          }
+        catch (std::runtime_error &e)
+          {
+            // No exception handling here.
+          }
+      }
+
+    MPI_Comm group_communicator;
+    MPI_Comm_split(MPI_COMM_WORLD, group, rank, &group_communicator);
+
+    if (Utilities::MPI::this_mpi_process(group_communicator) == 0)
+      {
+        std::cout << "Rank " << rank << " leads group " << group << " with "
+                  << Utilities::MPI::n_mpi_processes(group_communicator)
+                  << " rank(s)." << std::endl;
+      }
+
+    for (unsigned int run = group; run < parameter_filenames.size();
+         run += n_used_groups)
+      {
+        const std::string output_directory =
+          "output/" + Utilities::int_to_string(run, 3) + "-" +
+          std::filesystem::path(parameter_filenames[run]).stem().string() +
+          "/";
+
+        const ParameterFile parameter_file(parameter_filenames[run],
+                                           group_communicator,
+                                           output_directory);
+        run_problem(parameter_file, group_communicator);
+      }
+
+    MPI_Comm_free(&group_communicator);
   }
 } // namespace Elasticity
\ No newline at end of file
@@ -0,0 +1,8 @@
+#include "two_level_schwarz.h"
+#include "two_level_schwarz.tpp"
+
+namespace Elasticity
+{
+  template class TwoLevelSchwarzPreconditioner<2>;
+  template class TwoLevelSchwarzPreconditioner<3>;
+}
\ No newline at end of file